@@ -0,0 +1,223 @@
+//
+//  allocation.h
+//  fbxtools
+//
+//  Created by LARRYHOU on 2026/10/19.
+//  Copyright © 2026 LARRYHOU. All rights reserved.
+//
+
+#ifndef allocation_h
+#define allocation_h
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <stdlib.h>
+#include <sys/stat.h>
+
+#include <archive.h>
+
+// bytes held by FBX SDK allocations made on one thread while the scope is active
+struct MemoryUsage
+{
+    long long current = 0;
+    long long peak = 0;
+    uint32_t scope = 0; // tags blocks allocated under it, never 0
+};
+
+namespace memory
+{
+    // keeps 16 byte alignment of the block behind it, magic tells our blocks from those of the default handlers
+    struct alignas(16) Header
+    {
+        size_t size;
+        uint32_t magic;
+        uint32_t scope;
+    };
+    
+    const uint32_t MAGIC = 0xfb7a110c;
+    
+    thread_local MemoryUsage *__usage = nullptr;
+    
+    // blocks the SDK got before install() or from its default handlers go back to those
+    void *(*__realloc)(void *, size_t) = realloc;
+    void (*__free)(void *) = free;
+    
+    Header *header(void *data)
+    {
+        auto header = static_cast<Header *>(data) - 1;
+        return header->magic == (MAGIC ^ (uint32_t)header->size) ? header : nullptr;
+    }
+    
+    Header *tag(Header *header, size_t size)
+    {
+        auto usage = __usage;
+        header->size = size;
+        header->magic = MAGIC ^ (uint32_t)size;
+        header->scope = usage != nullptr ? usage->scope : 0;
+        if (usage != nullptr)
+        {
+            usage->current += size;
+            if (usage->current > usage->peak) { usage->peak = usage->current; }
+        }
+        return header;
+    }
+    
+    // a block is only credited back to the scope that was charged for it, frees on other threads or after that
+    // scope ended aren't seen, so current of a scope may stay above what it still holds but never drops below
+    void untag(Header *header)
+    {
+        auto usage = __usage;
+        if (usage != nullptr && header->scope == usage->scope) { usage->current -= header->size; }
+        header->magic = 0;
+    }
+    
+    void *allocate(size_t size)
+    {
+        auto header = static_cast<Header *>(malloc(sizeof(Header) + size));
+        if (header == nullptr) { return nullptr; }
+        return tag(header, size) + 1;
+    }
+    
+    void *callocate(size_t count, size_t size)
+    {
+        if (size != 0 && count > (SIZE_MAX - sizeof(Header)) / size) { return nullptr; }
+        auto header = static_cast<Header *>(calloc(1, sizeof(Header) + count * size));
+        if (header == nullptr) { return nullptr; }
+        return tag(header, count * size) + 1;
+    }
+    
+    void *reallocate(void *data, size_t size)
+    {
+        if (data == nullptr) { return allocate(size); }
+        
+        auto block = header(data);
+        if (block == nullptr) { return __realloc(data, size); }
+        
+        auto previous = *block;
+        block = static_cast<Header *>(realloc(block, sizeof(Header) + size));
+        if (block == nullptr) { return nullptr; }
+        untag(&previous);
+        return tag(block, size) + 1;
+    }
+    
+    void release(void *data)
+    {
+        if (data == nullptr) { return; }
+        
+        auto block = header(data);
+        if (block == nullptr) { return __free(data); }
+        untag(block);
+        free(block);
+    }
+    
+#ifdef _FBXSDK_H_
+    // SDK allocations are counted per job from here on, must run before the first FbxManager is created,
+    // only available to tools that include the SDK ahead of this header
+    void install()
+    {
+        static std::once_flag once;
+        std::call_once(once, []
+        {
+            __realloc = FbxGetDefaultReallocHandler();
+            __free = FbxGetDefaultFreeHandler();
+            FbxSetMallocHandler(allocate);
+            FbxSetCallocHandler(callocate);
+            FbxSetReallocHandler(reallocate);
+            FbxSetFreeHandler(release);
+        });
+    }
+#endif
+    
+    // input bytes a job works on, archive entries count by their uncompressed size
+    long long footprint(const std::string &spec)
+    {
+        std::string file, entry;
+        if (archive::split(spec, file, entry))
+        {
+            archive::Location location;
+            MappedFile mapping;
+            if (mapping.open(file) && archive::locate(mapping, file, entry, location)) { return location.size; }
+            return 0;
+        }
+        
+        struct stat st;
+        return stat(spec.c_str(), &st) == 0 ? st.st_size : 0;
+    }
+}
+
+class MemoryScope
+{
+    MemoryUsage __usage;
+    MemoryUsage *__previous;
+    
+    static uint32_t next()
+    {
+        static std::atomic<uint32_t> counter(0);
+        uint32_t scope;
+        while ((scope = ++counter) == 0) {}
+        return scope;
+    }
+
+public:
+    MemoryScope(): __previous(memory::__usage)
+    {
+        __usage.scope = next();
+        memory::__usage = &__usage;
+    }
+    
+    ~MemoryScope() { memory::__usage = __previous; }
+    
+    long long peak() const { return __usage.peak; }
+};
+
+// admits jobs while the sum of their estimated peak memory fits the budget
+// estimate is input size times the largest peak/size ratio seen so far, decayed slowly toward recent jobs
+class MemoryBudget
+{
+    long long __limit;
+    long long __reserved = 0;
+    int __running = 0;
+    double __ratio = 16;
+    std::mutex __mutex;
+    std::condition_variable __condition;
+
+public:
+    MemoryBudget(long long limit): __limit(limit) {}
+    
+    bool enabled() const { return __limit > 0; }
+    
+    // blocks until the job fits, a job larger than the whole budget runs alone
+    long long acquire(long long size)
+    {
+        if (!enabled()) { return 0; }
+        
+        std::unique_lock<std::mutex> lock(__mutex);
+        auto amount = std::min(static_cast<long long>(size * __ratio), __limit);
+        __condition.wait(lock, [&]{ return __running == 0 || __reserved + amount <= __limit; });
+        __reserved += amount;
+        ++__running;
+        return amount;
+    }
+    
+    void release(long long amount, long long size, long long peak)
+    {
+        if (!enabled()) { return; }
+        
+        {
+            std::lock_guard<std::mutex> lock(__mutex);
+            __reserved -= amount;
+            --__running;
+            if (size > 0 && peak > 0)
+            {
+                auto ratio = static_cast<double>(peak) / size;
+                __ratio = ratio > __ratio ? ratio : __ratio * 0.9 + ratio * 0.1;
+            }
+        }
+        __condition.notify_all();
+    }
+};
+
+#endif /* allocation_h */
@@ -0,0 +1,405 @@
+//
+//  archive.h
+//  fbxtools
+//
+//  Created by LARRYHOU on 2026/10/19.
+//  Copyright © 2026 LARRYHOU. All rights reserved.
+//
+
+#ifndef archive_h
+#define archive_h
+
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <ctype.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <zlib.h>
+
+// whole file mapped read only
+class MappedFile
+{
+    const char *__data = nullptr;
+    size_t __size = 0;
+
+public:
+    MappedFile() {}
+    MappedFile(const MappedFile &) = delete;
+    ~MappedFile() { close(); }
+    
+    const char *data() const { return __data; }
+    size_t size() const { return __size; }
+    
+    bool open(const std::string &filename)
+    {
+        close();
+        auto fd = ::open(filename.c_str(), O_RDONLY);
+        if (fd < 0) { return false; }
+        
+        struct stat st;
+        if (fstat(fd, &st) != 0 || st.st_size == 0)
+        {
+            ::close(fd);
+            return false;
+        }
+        
+        auto data = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (data == MAP_FAILED) { return false; }
+        
+        __data = static_cast<const char *>(data);
+        __size = st.st_size;
+        return true;
+    }
+    
+    // read ahead of the range that is about to be consumed front to back
+    void advise(size_t offset, size_t size)
+    {
+        if (__data == nullptr || size == 0) { return; }
+        size_t page = sysconf(_SC_PAGESIZE);
+        auto begin = offset / page * page;
+        auto end = std::min(offset + size, __size);
+        auto ptr = const_cast<char *>(__data) + begin;
+        madvise(ptr, end - begin, MADV_SEQUENTIAL);
+        madvise(ptr, end - begin, MADV_WILLNEED);
+    }
+    
+    void close()
+    {
+        if (__data != nullptr) { munmap(const_cast<char *>(__data), __size); }
+        __data = nullptr;
+        __size = 0;
+    }
+};
+
+namespace archive
+{
+    uint16_t u16(const char *p)
+    {
+        auto b = reinterpret_cast<const uint8_t *>(p);
+        return b[0] | b[1] << 8;
+    }
+    
+    uint32_t u32(const char *p)
+    {
+        return u16(p) | (uint32_t)u16(p + 2) << 16;
+    }
+    
+    uint64_t u64(const char *p)
+    {
+        return u32(p) | (uint64_t)u32(p + 4) << 32;
+    }
+    
+    std::string lowercase(std::string s)
+    {
+        std::transform(s.begin(), s.end(), s.begin(), ::tolower);
+        return s;
+    }
+    
+    // archive.zip#path/model.fbx or archive.tar#path/model.fbx
+    bool split(const std::string &spec, std::string &file, std::string &entry)
+    {
+        auto pos = spec.find('#');
+        if (pos == std::string::npos || pos < 4) { return false; }
+        
+        auto extension = lowercase(spec.substr(pos - 4, 4));
+        if (extension != ".zip" && extension != ".tar") { return false; }
+        
+        file = spec.substr(0, pos);
+        entry = spec.substr(pos + 1);
+        while (entry.compare(0, 2, "./") == 0) { entry.erase(0, 2); }
+        while (!entry.empty() && entry[0] == '/') { entry.erase(0, 1); }
+        return !entry.empty();
+    }
+    
+    // same path as the spec for plain files, <archive stem>/<entry path> for archive entries
+    // so that outputs derived from it land beside the archive, directories are created on the way
+    std::string workpath(const std::string &spec)
+    {
+        std::string file, entry;
+        if (!split(spec, file, entry)) { return spec; }
+        
+        auto path = file.substr(0, file.size() - 4) + "/" + entry;
+        for (auto pos = path.find('/', 1); pos != std::string::npos; pos = path.find('/', pos + 1))
+        {
+            mkdir(path.substr(0, pos).c_str(), 0777);
+        }
+        return path;
+    }
+    
+    struct Location
+    {
+        size_t offset = 0;
+        size_t compressed = 0;
+        size_t size = 0;
+        int method = 0;
+    };
+    
+    // finds entry through zip central directory, zip64 included
+    bool zip(const MappedFile &file, const std::string &name, Location &location)
+    {
+        auto data = file.data();
+        auto size = file.size();
+        if (size < 22) { return false; }
+        
+        size_t eocd = size - 22;
+        auto limit = size > 22 + 0xFFFF ? size - 22 - 0xFFFF : 0;
+        while (u32(data + eocd) != 0x06054b50)
+        {
+            if (eocd == limit) { return false; }
+            --eocd;
+        }
+        
+        uint64_t entries = u16(data + eocd + 10);
+        uint64_t directory = u32(data + eocd + 16);
+        if ((entries == 0xFFFF || directory == 0xFFFFFFFF) && eocd >= 20 && u32(data + eocd - 20) == 0x07064b50)
+        {
+            auto record = u64(data + eocd - 20 + 8);
+            if (record + 56 > size || u32(data + record) != 0x06064b50) { return false; }
+            entries = u64(data + record + 32);
+            directory = u64(data + record + 48);
+        }
+        
+        auto ptr = directory;
+        for (uint64_t n = 0; n < entries; n++)
+        {
+            if (ptr + 46 > size || u32(data + ptr) != 0x02014b50) { return false; }
+            auto flags = u16(data + ptr + 8);
+            auto method = u16(data + ptr + 10);
+            uint64_t compressed = u32(data + ptr + 20);
+            uint64_t uncompressed = u32(data + ptr + 24);
+            auto nameLength = u16(data + ptr + 28);
+            auto extraLength = u16(data + ptr + 30);
+            auto commentLength = u16(data + ptr + 32);
+            uint64_t header = u32(data + ptr + 42);
+            if (ptr + 46 + nameLength + extraLength > size) { return false; }
+            
+            if (name.size() == nameLength && memcmp(data + ptr + 46, name.data(), nameLength) == 0)
+            {
+                // zip64 extra field only carries the values that overflowed
+                auto extra = data + ptr + 46 + nameLength;
+                auto end = extra + extraLength;
+                while (extra + 4 <= end)
+                {
+                    auto id = u16(extra);
+                    auto length = u16(extra + 2);
+                    auto field = extra + 4;
+                    if (id == 0x0001)
+                    {
+                        if (uncompressed == 0xFFFFFFFF && field + 8 <= end) { uncompressed = u64(field); field += 8; }
+                        if (compressed == 0xFFFFFFFF && field + 8 <= end) { compressed = u64(field); field += 8; }
+                        if (header == 0xFFFFFFFF && field + 8 <= end) { header = u64(field); field += 8; }
+                    }
+                    extra += 4 + length;
+                }
+                
+                if ((flags & 1) != 0) { return false; } // encrypted
+                if (header + 30 > size || u32(data + header) != 0x04034b50) { return false; }
+                location.offset = header + 30 + u16(data + header + 26) + u16(data + header + 28);
+                location.compressed = compressed;
+                location.size = uncompressed;
+                location.method = method;
+                return location.offset + compressed <= size;
+            }
+            
+            ptr += 46 + nameLength + extraLength + commentLength;
+        }
+        
+        return false;
+    }
+    
+    uint64_t octal(const char *field, size_t length)
+    {
+        if (static_cast<uint8_t>(field[0]) & 0x80)
+        { // GNU base-256 for sizes beyond 8GB
+            uint64_t value = field[0] & 0x7F;
+            for (size_t i = 1; i < length; i++) { value = value << 8 | static_cast<uint8_t>(field[i]); }
+            return value;
+        }
+        
+        uint64_t value = 0;
+        for (size_t i = 0; i < length && field[i] != 0; i++)
+        {
+            if (field[i] >= '0' && field[i] <= '7') { value = value * 8 + (field[i] - '0'); }
+        }
+        return value;
+    }
+    
+    std::string text(const char *field, size_t length)
+    {
+        return std::string(field, strnlen(field, length));
+    }
+    
+    // walks ustar headers, GNU long names and pax path records included
+    bool tar(const MappedFile &file, const std::string &name, Location &location)
+    {
+        auto data = file.data();
+        auto size = file.size();
+        
+        std::string longname;
+        size_t ptr = 0;
+        while (ptr + 512 <= size)
+        {
+            auto header = data + ptr;
+            if (header[0] == 0) { break; }
+            
+            auto length = octal(header + 124, 12);
+            auto type = header[156];
+            auto content = ptr + 512;
+            if (content + length > size) { return false; }
+            
+            auto path = longname;
+            longname.clear();
+            if (path.empty())
+            {
+                path = text(header, 100);
+                if (memcmp(header + 257, "ustar", 5) == 0 && header[345] != 0)
+                {
+                    path = text(header + 345, 155) + "/" + path;
+                }
+            }
+            
+            if (type == 'L')
+            {
+                longname = text(data + content, length);
+            }
+            else if (type == 'x')
+            {
+                // records of "<length> <key>=<value>\n"
+                auto record = data + content;
+                auto end = record + length;
+                while (record < end)
+                {
+                    auto count = atoi(record);
+                    if (count <= 0 || record + count > end) { break; }
+                    auto line = std::string(record, count);
+                    auto space = line.find(' ');
+                    if (line.compare(space + 1, 5, "path=") == 0)
+                    {
+                        longname = line.substr(space + 6, line.size() - space - 7);
+                    }
+                    record += count;
+                }
+            }
+            else if ((type == '0' || type == 0) && path == name)
+            {
+                location.offset = content;
+                location.compressed = length;
+                location.size = length;
+                location.method = 0;
+                return true;
+            }
+            
+            ptr = content + (length + 511) / 512 * 512;
+        }
+        
+        return false;
+    }
+    
+    bool locate(const MappedFile &file, const std::string &filename, const std::string &entry, Location &location)
+    {
+        auto extension = lowercase(filename.substr(filename.size() - 4));
+        return extension == ".zip" ? zip(file, entry, location) : tar(file, entry, location);
+    }
+    
+    bool inflate(const char *data, size_t size, std::vector<char> &output)
+    {
+        z_stream stream;
+        memset(&stream, 0, sizeof(stream));
+        if (inflateInit2(&stream, -MAX_WBITS) != Z_OK) { return false; }
+        
+        auto status = Z_OK;
+        size_t consumed = 0, produced = 0;
+        while (status == Z_OK)
+        {
+            // z_stream counters are 32 bits, feed large entries in slices
+            stream.next_in = (Bytef *)(data + consumed);
+            stream.avail_in = (uInt)std::min(size - consumed, (size_t)UINT_MAX);
+            stream.next_out = (Bytef *)(output.data() + produced);
+            stream.avail_out = (uInt)std::min(output.size() - produced, (size_t)UINT_MAX);
+            auto in = stream.avail_in, out = stream.avail_out;
+            status = ::inflate(&stream, Z_NO_FLUSH);
+            consumed += in - stream.avail_in;
+            produced += out - stream.avail_out;
+            if (status == Z_BUF_ERROR && produced < output.size() && consumed < size) { status = Z_OK; }
+        }
+        
+        inflateEnd(&stream);
+        return status == Z_STREAM_END && produced == output.size();
+    }
+}
+
+// bytes of a plain file or an archive entry, stored entries are served straight from the mapped archive
+class MappedSource
+{
+    MappedFile __file;
+    std::vector<char> __inflated;
+    const char *__data = nullptr;
+    size_t __size = 0;
+
+public:
+    MappedSource() {}
+    MappedSource(const MappedSource &) = delete;
+    
+    const char *data() const { return __data; }
+    size_t size() const { return __size; }
+    
+    bool open(const std::string &spec)
+    {
+        close();
+        
+        std::string filename, entry;
+        if (!archive::split(spec, filename, entry))
+        {
+            if (!__file.open(spec)) { return false; }
+            __file.advise(0, __file.size());
+            __data = __file.data();
+            __size = __file.size();
+            return true;
+        }
+        
+        if (!__file.open(filename)) { return false; }
+        
+        archive::Location location;
+        if (!archive::locate(__file, filename, entry, location)) { close(); return false; }
+        
+        __file.advise(location.offset, location.compressed);
+        if (location.method == 0)
+        {
+            __data = __file.data() + location.offset;
+            __size = location.size;
+            return true;
+        }
+        
+        if (location.method != 8) { close(); return false; } // deflate only
+        
+        __inflated.resize(location.size);
+        if (!archive::inflate(__file.data() + location.offset, location.compressed, __inflated))
+        {
+            close();
+            return false;
+        }
+        
+        __file.close();
+        __data = __inflated.data();
+        __size = __inflated.size();
+        return true;
+    }
+    
+    void close()
+    {
+        __file.close();
+        std::vector<char>().swap(__inflated);
+        __data = nullptr;
+        __size = 0;
+    }
+};
+
+#endif /* archive_h */
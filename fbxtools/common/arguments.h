@@ -9,8 +9,13 @@
 #ifndef arguments_h
 #define arguments_h
 
+#include <algorithm>
+#include <functional>
 #include <sstream>
+#include <stdlib.h>
 #include <string>
+#include <thread>
+#include <vector>
 #include <map>
 
 enum TerminalFilter
@@ -59,6 +64,22 @@ struct ArgumentOptions
         }
     }
     
+    // options given apart from the file, eg. from a request line, take precedence over ?options
+    ArgumentOptions(std::string file, const std::map<std::string, std::string> &options): ArgumentOptions(file)
+    {
+        for (auto iter = options.begin(); iter != options.end(); iter++)
+        {
+            data[iter->first] = iter->second;
+        }
+        if (!options.empty()) { filter = ::info; }
+    }
+    
+    // command line defaults go in as if given with the file, so they are part of the cache key too
+    void inherit(const std::map<std::string, std::string> &defaults)
+    {
+        data.insert(defaults.begin(), defaults.end());
+    }
+    
     virtual bool get(std::string key)
     {
         auto iter = data.find(key);
@@ -82,4 +103,98 @@ struct ArgumentOptions
     }
 };
 
+#define FBXTOOLS_VERSION "1.1"
+
+struct CommandOptions
+{
+    int jobs = 1;
+    std::vector<std::string> files;
+    
+    std::string cache;
+    long long cacheLimit = 8LL << 30;
+    bool stats = false;
+    long long memory = 0; // budget of concurrent jobs, 0 for none
+    
+    std::string serve;   // unix socket to listen on
+    std::string connect; // unix socket of a running server
+    std::string manifest; // job list file, - for stdin
+    
+    // ?options every job gets unless it gives its own, from --format, --fbx-version, --compress-level and --compress-minsize
+    std::map<std::string, std::string> defaults;
+    
+    CommandOptions(int argc, const char *argv[])
+    {
+        auto env = getenv("FBXTOOLS_CACHE");
+        if (env != nullptr) { cache = env; }
+        
+        for (auto i = 1; i < argc; i++)
+        {
+            std::string arg(argv[i]);
+            if (arg == "--cache" && i + 1 < argc)
+            {
+                cache = argv[++i];
+            }
+            else if (arg == "--cache-size" && i + 1 < argc)
+            {
+                cacheLimit = atoll(argv[++i]) << 20; // MB
+            }
+            else if (arg == "--memory" && i + 1 < argc)
+            {
+                memory = atoll(argv[++i]) << 20; // MB
+            }
+            else if (arg == "--no-cache")
+            {
+                cache.clear();
+            }
+            else if (arg == "--serve" && i + 1 < argc)
+            {
+                serve = argv[++i];
+            }
+            else if (arg == "--connect" && i + 1 < argc)
+            {
+                connect = argv[++i];
+            }
+            else if (arg == "--manifest" && i + 1 < argc)
+            {
+                manifest = argv[++i];
+            }
+            else if (arg == "--format" && i + 1 < argc)
+            {
+                defaults["format"] = argv[++i];
+            }
+            else if (arg == "--fbx-version" && i + 1 < argc)
+            {
+                defaults["fbxversion"] = argv[++i];
+            }
+            else if (arg == "--compress-level" && i + 1 < argc)
+            {
+                defaults["compresslevel"] = argv[++i];
+            }
+            else if (arg == "--compress-minsize" && i + 1 < argc)
+            {
+                defaults["compressmin"] = argv[++i];
+            }
+            else if (arg == "--stats")
+            {
+                stats = true;
+            }
+            else if (arg == "-j" && i + 1 < argc)
+            {
+                jobs = atoi(argv[++i]);
+            }
+            else if (arg.size() > 2 && arg.compare(0, 2, "-j") == 0)
+            {
+                jobs = atoi(arg.c_str() + 2);
+            }
+            else
+            {
+                files.push_back(arg);
+            }
+        }
+        
+        // -j 0 means one worker per core
+        if (jobs <= 0) { jobs = std::max(1, (int)std::thread::hardware_concurrency()); }
+    }
+};
+
 #endif /* arguments_h */
@@ -0,0 +1,459 @@
+//
+//  cache.h
+//  fbxtools
+//
+//  Created by LARRYHOU on 2026/10/19.
+//  Copyright © 2026 LARRYHOU. All rights reserved.
+//
+
+#ifndef cache_h
+#define cache_h
+
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <dirent.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <unistd.h>
+#ifdef __APPLE__
+#include <mach-o/dyld.h>
+#endif
+
+#include <arguments.h>
+#include <workers.h>
+#include <archive.h>
+
+// 64-bit streaming hash, eight bytes per step
+class ContentHash
+{
+    uint64_t __state;
+    uint64_t __length = 0;
+    uint8_t __tail[8];
+    size_t __tailSize = 0;
+    
+    static const uint64_t PRIME1 = 0x9E3779B185EBCA87ULL;
+    static const uint64_t PRIME2 = 0xC2B2AE3D27D4EB4FULL;
+    
+    static uint64_t rotate(uint64_t v, int bits) { return (v << bits) | (v >> (64 - bits)); }
+    
+    void mix(uint64_t word)
+    {
+        __state ^= rotate(word * PRIME2, 31) * PRIME1;
+        __state = rotate(__state, 27) * PRIME1 + PRIME2;
+    }
+
+public:
+    ContentHash(uint64_t seed = 0): __state(seed + PRIME1) {}
+    
+    ContentHash &update(const void *data, size_t size)
+    {
+        auto ptr = static_cast<const uint8_t *>(data);
+        __length += size;
+        if (__tailSize > 0)
+        {
+            while (__tailSize < 8 && size > 0) { __tail[__tailSize++] = *ptr++; --size; }
+            if (__tailSize < 8) { return *this; }
+            uint64_t word;
+            memcpy(&word, __tail, 8);
+            mix(word);
+            __tailSize = 0;
+        }
+        
+        while (size >= 8)
+        {
+            uint64_t word;
+            memcpy(&word, ptr, 8);
+            mix(word);
+            ptr += 8;
+            size -= 8;
+        }
+        
+        while (size > 0) { __tail[__tailSize++] = *ptr++; --size; }
+        return *this;
+    }
+    
+    ContentHash &update(const std::string &text)
+    {
+        auto size = static_cast<uint32_t>(text.size());
+        update(&size, sizeof(size));
+        return update(text.data(), text.size());
+    }
+    
+    uint64_t digest() const
+    {
+        auto h = __state ^ (__length * PRIME2);
+        for (size_t i = 0; i < __tailSize; i++) { h = rotate(h ^ (__tail[i] * PRIME1), 11) * PRIME2; }
+        h ^= h >> 33;
+        h *= PRIME2;
+        h ^= h >> 29;
+        h *= PRIME1;
+        h ^= h >> 32;
+        return h;
+    }
+    
+    static std::string hex(uint64_t value)
+    {
+        char text[17];
+        snprintf(text, sizeof(text), "%016llx", (unsigned long long)value);
+        return text;
+    }
+    
+    static bool file(const std::string &filename, ContentHash &hash)
+    {
+        auto fd = open(filename.c_str(), O_RDONLY);
+        if (fd < 0) { return false; }
+        
+        std::vector<char> buffer(1 << 20);
+        ssize_t size;
+        while ((size = read(fd, buffer.data(), buffer.size())) > 0)
+        {
+            hash.update(buffer.data(), size);
+        }
+        close(fd);
+        return size == 0;
+    }
+};
+
+namespace cache
+{
+    // nanoseconds, for telling a file changed along with its size
+    long long mtime(const struct stat &st)
+    {
+#ifdef __APPLE__
+        return (long long)st.st_mtimespec.tv_sec * 1000000000LL + st.st_mtimespec.tv_nsec;
+#else
+        return (long long)st.st_mtim.tv_sec * 1000000000LL + st.st_mtim.tv_nsec;
+#endif
+    }
+    
+    // content hash of the running executable, so a rebuilt tool never restores what an older build produced
+    // without waiting for FBXTOOLS_VERSION to be bumped, build time of this unit when the executable can't be read
+    std::string build()
+    {
+        static std::string id;
+        static std::once_flag once;
+        std::call_once(once, []
+        {
+            char path[PATH_MAX];
+#ifdef __APPLE__
+            uint32_t size = sizeof(path);
+            auto found = _NSGetExecutablePath(path, &size) == 0;
+#else
+            auto length = readlink("/proc/self/exe", path, sizeof(path) - 1);
+            auto found = length > 0;
+            if (found) { path[length] = 0; }
+#endif
+            ContentHash hash;
+            id = found && ContentHash::file(path, hash) ? ContentHash::hex(hash.digest()) : std::string(__DATE__ " " __TIME__);
+        });
+        return id;
+    }
+}
+
+// persistent store of job outputs keyed by input content, options, tool version and build
+// layout: <root>/<2 hex>/<14 hex>/{manifest,log,0,1,...}
+class BuildCache
+{
+    std::string __root;
+    std::string __tool;
+    long long __limit;
+    bool __verbose;
+    
+    std::atomic<int> __hits;
+    std::atomic<int> __skips;
+    std::atomic<int> __misses;
+    std::atomic<int> __stores;
+    std::atomic<long long> __restored;
+    
+    struct Output
+    {
+        std::string path;
+        long long size;
+        long long mtime;
+    };
+    
+    struct Entry
+    {
+        std::string path;
+        long long size;
+        time_t atime;
+    };
+    
+    static void mkdirs(const std::string &path)
+    {
+        for (size_t pos = 1; pos < path.size(); pos++)
+        {
+            if (path[pos] == '/') { mkdir(path.substr(0, pos).c_str(), 0777); }
+        }
+        mkdir(path.c_str(), 0777);
+    }
+    
+    static bool copy(const std::string &src, const std::string &dst)
+    {
+        auto in = open(src.c_str(), O_RDONLY);
+        if (in < 0) { return false; }
+        auto out = open(dst.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (out < 0) { close(in); return false; }
+        
+        std::vector<char> buffer(1 << 20);
+        ssize_t size;
+        auto success = true;
+        while ((size = read(in, buffer.data(), buffer.size())) > 0)
+        {
+            if (write(out, buffer.data(), size) != size) { success = false; break; }
+        }
+        close(in);
+        close(out);
+        return success && size == 0;
+    }
+    
+    static void remove(const std::string &path)
+    {
+        auto dir = opendir(path.c_str());
+        if (dir == nullptr) { unlink(path.c_str()); return; }
+        struct dirent *item;
+        while ((item = readdir(dir)) != nullptr)
+        {
+            if (strcmp(item->d_name, ".") == 0 || strcmp(item->d_name, "..") == 0) { continue; }
+            remove(path + "/" + item->d_name);
+        }
+        closedir(dir);
+        rmdir(path.c_str());
+    }
+    
+    static std::vector<std::string> list(const std::string &path)
+    {
+        std::vector<std::string> names;
+        auto dir = opendir(path.c_str());
+        if (dir == nullptr) { return names; }
+        struct dirent *item;
+        while ((item = readdir(dir)) != nullptr)
+        {
+            if (item->d_name[0] == '.') { continue; }
+            names.push_back(item->d_name);
+        }
+        closedir(dir);
+        return names;
+    }
+    
+    std::string key(const ArgumentOptions &fo, bool &success)
+    {
+        ContentHash hash;
+        hash.update(__tool);
+        hash.update(fo.filename);
+        for (auto iter = fo.data.begin(); iter != fo.data.end(); iter++)
+        {
+            hash.update(iter->first);
+            hash.update(iter->second);
+        }
+        std::string file, entry;
+        if (archive::split(fo.filename, file, entry))
+        {
+            MappedSource source;
+            success = source.open(fo.filename);
+            if (success) { hash.update(source.data(), source.size()); }
+        }
+        else
+        {
+            success = ContentHash::file(fo.filename, hash);
+        }
+        auto digest = ContentHash::hex(hash.digest());
+        return __root + "/" + digest.substr(0, 2) + "/" + digest.substr(2);
+    }
+    
+    bool restore(const std::string &entry, JobRecord &record)
+    {
+        std::ifstream manifest(entry + "/manifest");
+        std::string line;
+        if (!std::getline(manifest, line) || line != "fbxtools-cache 1") { return false; }
+        
+        std::vector<Output> outputs;
+        JobRecord cached;
+        while (std::getline(manifest, line))
+        {
+            std::istringstream stream(line);
+            std::string kind;
+            stream >> kind;
+            if (kind == "output")
+            {
+                Output o;
+                stream >> o.size >> o.mtime;
+                stream.get();
+                std::getline(stream, o.path);
+                outputs.push_back(o);
+            }
+            else if (kind == "counter")
+            {
+                std::string name;
+                long long value;
+                stream >> name >> value;
+                cached.counters[name] = value;
+            }
+        }
+        
+        auto skipped = true;
+        for (auto i = 0; i < outputs.size(); i++)
+        {
+            auto &o = outputs[i];
+            struct stat st;
+            if (stat(o.path.c_str(), &st) == 0 && st.st_size == o.size && cache::mtime(st) == o.mtime) { continue; }
+            
+            auto blob = entry + "/" + std::to_string(i);
+            auto sep = o.path.rfind('/');
+            if (sep != std::string::npos) { mkdirs(o.path.substr(0, sep)); }
+            if (!copy(blob, o.path)) { return false; }
+            
+            struct timespec times[2];
+            times[0].tv_sec = times[1].tv_sec = o.mtime / 1000000000LL;
+            times[0].tv_nsec = times[1].tv_nsec = o.mtime % 1000000000LL;
+            utimensat(AT_FDCWD, o.path.c_str(), times, 0);
+            __restored += o.size;
+            skipped = false;
+        }
+        
+        for (auto iter = outputs.begin(); iter != outputs.end(); iter++) { cached.outputs.push_back(iter->path); }
+        record = cached;
+        
+        std::ifstream log(entry + "/log", std::ios::binary);
+        std::stringstream text;
+        text << log.rdbuf();
+        output(text.str());
+        
+        utimes((entry + "/manifest").c_str(), nullptr); // LRU stamp
+        ++__hits;
+        if (skipped) { ++__skips; }
+        return true;
+    }
+    
+    void store(const std::string &entry, const JobRecord &record, const std::string &log)
+    {
+        char suffix[64];
+        snprintf(suffix, sizeof(suffix), ".%d.%zx", getpid(), std::hash<std::thread::id>()(std::this_thread::get_id()));
+        auto staging = entry + suffix;
+        mkdirs(staging);
+        
+        std::ofstream manifest(staging + "/manifest");
+        manifest << "fbxtools-cache 1\n";
+        for (auto i = 0; i < record.outputs.size(); i++)
+        {
+            auto &path = record.outputs[i];
+            struct stat st;
+            if (stat(path.c_str(), &st) != 0 || !copy(path, staging + "/" + std::to_string(i)))
+            {
+                manifest.close();
+                remove(staging);
+                return;
+            }
+            manifest << "output " << (long long)st.st_size << " " << cache::mtime(st) << " " << path << "\n";
+        }
+        for (auto iter = record.counters.begin(); iter != record.counters.end(); iter++)
+        {
+            manifest << "counter " << iter->first << " " << iter->second << "\n";
+        }
+        manifest.close();
+        
+        std::ofstream(staging + "/log", std::ios::binary) << log;
+        if (rename(staging.c_str(), entry.c_str()) != 0) { remove(staging); return; }
+        ++__stores;
+    }
+
+public:
+    BuildCache(const CommandOptions &options, std::string tool, std::string version):
+        __root(options.cache), __tool(tool + " " + version + (options.cache.empty() ? "" : " " + cache::build())), __limit(options.cacheLimit), __verbose(options.stats),
+        __hits(0), __skips(0), __misses(0), __stores(0), __restored(0) {}
+    
+    bool enabled() const { return !__root.empty(); }
+    
+    // serves the job from cache when inputs are unchanged, otherwise runs it and stores what it produced
+    bool run(const ArgumentOptions &fo, JobRecord &record, std::function<bool()> process)
+    {
+        JobScope scope(record);
+        if (!enabled()) { return process(); }
+        
+        auto hashed = false;
+        auto entry = key(fo, hashed);
+        if (hashed && restore(entry, record)) { return true; }
+        
+        ++__misses;
+        std::string log;
+        auto success = false;
+        {
+            ConsoleCapture capture;
+            success = process();
+            log.swap(capture.text());
+        }
+        output(log);
+        
+        if (success && hashed) { store(entry, record, log); }
+        return success;
+    }
+    
+    // drops least recently used entries until the cache fits its size limit
+    int evict(FILE *stream = stdout)
+    {
+        if (!enabled() || __limit <= 0) { return 0; }
+        
+        std::vector<Entry> entries;
+        long long total = 0;
+        auto buckets = list(__root);
+        for (auto b = buckets.begin(); b != buckets.end(); b++)
+        {
+            auto names = list(__root + "/" + *b);
+            for (auto n = names.begin(); n != names.end(); n++)
+            {
+                Entry entry;
+                entry.path = __root + "/" + *b + "/" + *n;
+                entry.size = 0;
+                entry.atime = 0;
+                
+                struct stat st;
+                if (stat((entry.path + "/manifest").c_str(), &st) == 0) { entry.atime = st.st_mtime; }
+                auto files = list(entry.path);
+                for (auto f = files.begin(); f != files.end(); f++)
+                {
+                    if (stat((entry.path + "/" + *f).c_str(), &st) == 0) { entry.size += st.st_size; }
+                }
+                total += entry.size;
+                entries.push_back(entry);
+            }
+        }
+        
+        std::sort(entries.begin(), entries.end(), [](const Entry &a, const Entry &b) { return a.atime < b.atime; });
+        
+        auto evicted = 0;
+        for (auto iter = entries.begin(); iter != entries.end() && total > __limit; iter++)
+        {
+            remove(iter->path);
+            total -= iter->size;
+            ++evicted;
+        }
+        
+        if (__verbose)
+        {
+            fprintf(stream, "[cache] %s %.1fMB in %d entries, evicted %d\n", __root.c_str(), total / 1048576.0, (int)entries.size() - evicted, evicted);
+        }
+        return evicted;
+    }
+    
+    void report(FILE *stream = stdout)
+    {
+        if (!__verbose) { return; }
+        
+        int hits = __hits, misses = __misses;
+        auto rate = hits + misses == 0 ? 0.0 : 100.0 * hits / (hits + misses);
+        fprintf(stream, "[cache] hits=%d (up-to-date=%d restored=%d) misses=%d stored=%d hit-rate=%.1f%% restored=%.1fMB\n",
+               hits, (int)__skips, hits - (int)__skips, misses, (int)__stores, rate, __restored / 1048576.0);
+    }
+};
+
+#endif /* cache_h */
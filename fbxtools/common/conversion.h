@@ -0,0 +1,231 @@
+//
+//  conversion.h
+//  fbxtools
+//
+//  Created by LARRYHOU on 2026/10/19.
+//  Copyright © 2026 LARRYHOU. All rights reserved.
+//
+
+#ifndef conversion_h
+#define conversion_h
+
+#include <stddef.h>
+
+// axis and unit change between two coordinate systems as one 3x3 matrix and a scale, target = scale * matrix * source,
+// applied in place over strided double arrays, FbxVector4 and FbxVector3 buffers are 4 and 3 doubles per element
+class CoordinateConversion
+{
+    double __matrix[9]; // row major, rows are orthonormal
+    double __scale;
+    double __handedness; // determinant
+    
+    // axis changes are signed permutations, then every component is a plain multiply of one source component
+    bool __permutation;
+    int __axes[3];
+    double __signs[3];
+    
+    void prepare()
+    {
+        auto m = __matrix;
+        __handedness = m[0] * (m[4] * m[8] - m[5] * m[7]) - m[1] * (m[3] * m[8] - m[5] * m[6]) + m[2] * (m[3] * m[7] - m[4] * m[6]);
+        
+        __permutation = true;
+        for (auto r = 0; r < 3; r++)
+        {
+            auto count = 0;
+            for (auto c = 0; c < 3; c++)
+            {
+                auto v = m[r * 3 + c];
+                if (v == 0) { continue; }
+                if (v != 1 && v != -1) { __permutation = false; }
+                __axes[r] = c;
+                __signs[r] = v;
+                ++count;
+            }
+            if (count != 1) { __permutation = false; }
+        }
+    }
+    
+    // columns are right, up and toward the camera of an FbxAxisSystem in its own coordinates
+    template<typename Axes>
+    static void basis(const Axes &axes, double *m)
+    {
+        int upSign, frontSign;
+        auto up = (int)axes.GetUpVector(upSign) - Axes::eXAxis;
+        auto front = axes.GetFrontVector(frontSign) == Axes::eParityEven ? (up == 0 ? 1 : 0) : (up == 2 ? 1 : 2);
+        
+        double u[3] = {0, 0, 0};
+        double f[3] = {0, 0, 0};
+        u[up] = upSign;
+        f[front] = frontSign;
+        
+        // the third axis follows from handedness, right = up x front or front x up
+        double r[3] = {u[1] * f[2] - u[2] * f[1], u[2] * f[0] - u[0] * f[2], u[0] * f[1] - u[1] * f[0]};
+        auto sign = axes.GetCoorSystem() == Axes::eRightHanded ? 1 : -1;
+        for (auto i = 0; i < 3; i++)
+        {
+            m[i * 3 + 0] = sign * r[i];
+            m[i * 3 + 1] = u[i];
+            m[i * 3 + 2] = f[i];
+        }
+    }
+
+public:
+    CoordinateConversion(const double *matrix = nullptr, double scale = 1): __scale(scale)
+    {
+        for (auto i = 0; i < 9; i++) { __matrix[i] = matrix ? matrix[i] : (i % 4 == 0 ? 1 : 0); }
+        prepare();
+    }
+    
+    // e.g. between(FbxAxisSystem::DirectX, FbxSystemUnit::cm, FbxAxisSystem::OpenGL, FbxSystemUnit::m), multipliers are ignored as fbxdump always did
+    template<typename Axes, typename Unit>
+    static CoordinateConversion between(const Axes &from, const Unit &fromUnit, const Axes &to, const Unit &toUnit)
+    {
+        auto conversion = between(from, to);
+        conversion.__scale = units(fromUnit, toUnit).__scale;
+        return conversion;
+    }
+    
+    template<typename Axes>
+    static CoordinateConversion between(const Axes &from, const Axes &to)
+    {
+        double s[9], t[9], m[9];
+        basis(from, s);
+        basis(to, t);
+        
+        // target = T * transpose(S) * source, both bases are orthonormal
+        for (auto r = 0; r < 3; r++)
+        {
+            for (auto c = 0; c < 3; c++)
+            {
+                m[r * 3 + c] = t[r * 3 + 0] * s[c * 3 + 0] + t[r * 3 + 1] * s[c * 3 + 1] + t[r * 3 + 2] * s[c * 3 + 2];
+            }
+        }
+        return CoordinateConversion(m);
+    }
+    
+    // unit change only, e.g. units(scene unit, FbxSystemUnit::m)
+    template<typename Unit>
+    static CoordinateConversion units(const Unit &from, const Unit &to)
+    {
+        return CoordinateConversion(nullptr, from.GetScaleFactor() / to.GetScaleFactor());
+    }
+    
+    CoordinateConversion inverse() const
+    {
+        double m[9];
+        for (auto r = 0; r < 3; r++)
+        {
+            for (auto c = 0; c < 3; c++) { m[r * 3 + c] = __matrix[c * 3 + r]; }
+        }
+        return CoordinateConversion(m, 1 / __scale);
+    }
+    
+    const double *matrix() const { return __matrix; }
+    double scale() const { return __scale; }
+    bool mirrored() const { return __handedness < 0; }
+    
+    bool identity() const
+    {
+        if (__scale != 1 || !__permutation) { return false; }
+        for (auto i = 0; i < 3; i++)
+        {
+            if (__axes[i] != i || __signs[i] != 1) { return false; }
+        }
+        return true;
+    }
+    
+    void points(double *data, size_t count, size_t stride = 3) const { transform(data, count, stride, __scale); }
+    
+    // normals as well, the matrix is orthonormal so no inverse transpose is needed
+    void directions(double *data, size_t count, size_t stride = 3) const { transform(data, count, stride, 1); }
+    
+    // xyz and the binormal sign in w, which flips with handedness
+    void tangents(double *data, size_t count, size_t stride = 4) const
+    {
+        transform(data, count, stride, 1);
+        if (!mirrored()) { return; }
+        for (size_t i = 0; i < count; i++) { data[i * stride + 3] = -data[i * stride + 3]; }
+    }
+    
+    // affine 4x4 of FbxAMatrix layout, row vectors with translation in the last row,
+    // rotation becomes M * R * transpose(M) and translation scale * M * t, the w column is kept
+    void matrices(double *data, size_t count) const
+    {
+        for (size_t n = 0; n < count; n++, data += 16)
+        {
+            double t[9];
+            for (auto r = 0; r < 3; r++)
+            {
+                for (auto c = 0; c < 3; c++) { t[r * 3 + c] = right(data + r * 4, c); }
+            }
+            
+            for (auto r = 0; r < 3; r++)
+            {
+                for (auto c = 0; c < 3; c++) { data[r * 4 + c] = left(t, r, c); }
+            }
+            transform(data + 12, 1, 4, __scale);
+        }
+    }
+
+private:
+    // (row * transpose(M))[c]
+    double right(const double *row, int c) const
+    {
+        if (__permutation) { return __signs[c] * row[__axes[c]]; }
+        auto m = __matrix + c * 3;
+        return row[0] * m[0] + row[1] * m[1] + row[2] * m[2];
+    }
+    
+    // (M * t)[r][c] for a row major 3x3 t
+    double left(const double *t, int r, int c) const
+    {
+        if (__permutation) { return __signs[r] * t[__axes[r] * 3 + c]; }
+        auto m = __matrix + r * 3;
+        return m[0] * t[c] + m[1] * t[3 + c] + m[2] * t[6 + c];
+    }
+    
+    // plain strided loops without intrinsics, vectorized by the compiler for each stride
+    void transform(double *data, size_t count, size_t stride, double scale) const
+    {
+        if (__permutation)
+        {
+            auto a0 = __axes[0], a1 = __axes[1], a2 = __axes[2];
+            auto s0 = __signs[0] * scale, s1 = __signs[1] * scale, s2 = __signs[2] * scale;
+            if (a0 == 0 && a1 == 1 && a2 == 2)
+            {
+                if (s0 == 1 && s1 == 1 && s2 == 1) { return; }
+                for (size_t i = 0; i < count; i++)
+                {
+                    auto v = data + i * stride;
+                    v[0] *= s0;
+                    v[1] *= s1;
+                    v[2] *= s2;
+                }
+                return;
+            }
+            
+            for (size_t i = 0; i < count; i++)
+            {
+                auto v = data + i * stride;
+                double x = v[a0], y = v[a1], z = v[a2];
+                v[0] = s0 * x;
+                v[1] = s1 * y;
+                v[2] = s2 * z;
+            }
+            return;
+        }
+        
+        auto m = __matrix;
+        for (size_t i = 0; i < count; i++)
+        {
+            auto v = data + i * stride;
+            double x = v[0], y = v[1], z = v[2];
+            v[0] = (m[0] * x + m[1] * y + m[2] * z) * scale;
+            v[1] = (m[3] * x + m[4] * y + m[5] * z) * scale;
+            v[2] = (m[6] * x + m[7] * y + m[8] * z) * scale;
+        }
+    }
+};
+
+#endif /* conversion_h */
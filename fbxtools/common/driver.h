@@ -0,0 +1,572 @@
+//
+//  driver.h
+//  fbxtools
+//
+//  Created by LARRYHOU on 2026/10/19.
+//  Copyright © 2026 LARRYHOU. All rights reserved.
+//
+
+#ifndef driver_h
+#define driver_h
+
+#include <atomic>
+#include <chrono>
+#include <limits.h>
+#include <list>
+#include <memory>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <arguments.h>
+#include <workers.h>
+#include <cache.h>
+#include <json.h>
+#include <allocation.h>
+#include <archive.h>
+
+// everything a tool plugs into the shared batch, server and client loops
+template<typename Context>
+struct ToolDriver
+{
+    std::string name;
+    std::string version;
+    
+    std::function<Context *()> create;
+    std::function<void(Context *)> destroy;
+    
+    // runs one job, prints through output() and reports files through produced()
+    std::function<bool(Context *, ArgumentOptions &)> process;
+    
+    // optional, printed ahead of every job in batch and client mode
+    std::function<void(ArgumentOptions &, int, int)> announce;
+    
+    // optional, called with what a job produced, possibly from a worker thread
+    std::function<void(int, ArgumentOptions &, JobRecord &)> finished;
+};
+
+namespace driver
+{
+    // job description carried by a request line: {"file": "...", "options": {...}}
+    bool job(const Json &request, ArgumentOptions &args)
+    {
+        auto file = request.find("file");
+        if (file == nullptr || file->type != Json::eString) { return false; }
+        
+        std::map<std::string, std::string> options;
+        auto params = request.find("options");
+        if (params != nullptr && params->type == Json::eObject)
+        {
+            for (auto iter = params->members.begin(); iter != params->members.end(); iter++)
+            {
+                options[iter->first] = iter->second.str();
+            }
+        }
+        
+        args = ArgumentOptions(file->text, options);
+        return true;
+    }
+    
+    // one job per line, either a JSON request or a plain file?options spec as on the command line
+    bool job(const std::string &line, Json &request, ArgumentOptions &args)
+    {
+        if (line[0] != '{')
+        {
+            request = Json::object();
+            request.set("file", line);
+            args = ArgumentOptions(line);
+            return true;
+        }
+        return Json::parse(line, request) && job(request, args);
+    }
+    
+    std::string trim(const std::string &line)
+    {
+        auto begin = line.find_first_not_of(" \t\r");
+        if (begin == std::string::npos) { return std::string(); }
+        auto end = line.find_last_not_of(" \t\r");
+        return line.substr(begin, end - begin + 1);
+    }
+    
+    Json error(const Json &id, const std::string &message)
+    {
+        auto reply = Json::object();
+        reply.set("id", id);
+        reply.set("status", "error");
+        reply.set("error", message);
+        return reply;
+    }
+    
+    Json result(const std::string &tool, const ArgumentOptions &args, bool success, double seconds, const JobRecord &record, const std::string &log)
+    {
+        auto outputs = Json::array();
+        for (auto iter = record.outputs.begin(); iter != record.outputs.end(); iter++) { outputs.push(*iter); }
+        
+        auto counters = Json::object();
+        for (auto iter = record.counters.begin(); iter != record.counters.end(); iter++) { counters.set(iter->first, iter->second); }
+        
+        auto v = Json::object();
+        v.set("tool", tool);
+        v.set("file", args.filename);
+        v.set("status", success ? "ok" : "failed");
+        v.set("seconds", seconds);
+        v.set("outputs", outputs);
+        v.set("counters", counters);
+        v.set("log", log);
+        return v;
+    }
+    
+    void record(const Json &result, JobRecord &record)
+    {
+        auto outputs = result.find("outputs");
+        if (outputs != nullptr)
+        {
+            for (auto iter = outputs->items.begin(); iter != outputs->items.end(); iter++) { record.outputs.push_back(iter->text); }
+        }
+        
+        auto counters = result.find("counters");
+        if (counters != nullptr)
+        {
+            for (auto iter = counters->members.begin(); iter != counters->members.end(); iter++)
+            {
+                record.counters[iter->first] = (long long)iter->second.number;
+            }
+        }
+    }
+    
+    // runs one job under the memory budget, SDK allocations it makes are reported as "memory" counter
+    template<typename Context>
+    bool run(ToolDriver<Context> &tool, BuildCache &cache, MemoryBudget &budget, Context *context, ArgumentOptions &args, JobRecord &record)
+    {
+        auto size = budget.enabled() ? memory::footprint(args.filename) : 0;
+        auto amount = budget.acquire(size);
+        long long peak = 0;
+        auto success = cache.run(args, record, [&]
+        {
+            MemoryScope scope;
+            auto success = tool.process(context, args);
+            peak = scope.peak();
+            tally("memory", peak);
+            return success;
+        });
+        budget.release(amount, size, peak);
+        return success;
+    }
+    
+    template<typename Context>
+    Json execute(ToolDriver<Context> &tool, BuildCache &cache, MemoryBudget &budget, Context *context, ArgumentOptions &args)
+    {
+        auto start = std::chrono::steady_clock::now();
+        JobRecord record;
+        std::string log;
+        auto success = false;
+        {
+            ConsoleCapture capture;
+            success = run(tool, cache, budget, context, args, record);
+            log.swap(capture.text());
+        }
+        
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        return result(tool.name, args, success, elapsed.count(), record, log);
+    }
+    
+    class LineReader
+    {
+        int __fd;
+        std::string __buffer;
+        size_t __offset = 0;
+    
+    public:
+        LineReader(int fd): __fd(fd) {}
+        
+        bool next(std::string &line)
+        {
+            while (true)
+            {
+                auto pos = __buffer.find('\n', __offset);
+                if (pos != std::string::npos)
+                {
+                    line = __buffer.substr(__offset, pos - __offset);
+                    __offset = pos + 1;
+                    return true;
+                }
+                
+                __buffer.erase(0, __offset);
+                __offset = 0;
+                
+                char chunk[65536];
+                auto size = read(__fd, chunk, sizeof(chunk));
+                if (size < 0 && errno == EINTR) { continue; }
+                if (size <= 0)
+                {
+                    if (__buffer.empty()) { return false; }
+                    line.swap(__buffer);
+                    __buffer.clear();
+                    return true;
+                }
+                __buffer.append(chunk, size);
+            }
+        }
+    };
+    
+    bool send(int fd, const std::string &text)
+    {
+        size_t offset = 0;
+        while (offset < text.size())
+        {
+            auto size = write(fd, text.data() + offset, text.size() - offset);
+            if (size < 0 && errno == EINTR) { continue; }
+            if (size <= 0) { return false; }
+            offset += size;
+        }
+        return true;
+    }
+    
+    bool address(const std::string &path, sockaddr_un &addr)
+    {
+        memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        if (path.size() >= sizeof(addr.sun_path)) { return false; }
+        strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+        return true;
+    }
+    
+    std::string __socket;
+    
+    void terminate(int)
+    {
+        if (!__socket.empty()) { unlink(__socket.c_str()); }
+        _exit(0);
+    }
+    
+    struct Connection
+    {
+        int fd;
+        std::mutex mutex;
+        std::condition_variable condition;
+        int pending = 0;
+        std::atomic<bool> closed{false};
+    };
+    
+    // the server resolves paths against its own directory, so clients send them absolute,
+    // the archive part of an archive.zip#entry spec is resolved and the entry kept as is
+    std::string absolute(const std::string &spec)
+    {
+        std::string file, entry;
+        auto path = archive::split(spec, file, entry) ? file : spec;
+        
+        char resolved[PATH_MAX];
+        if (realpath(path.c_str(), resolved) != nullptr) { path = resolved; }
+        else if (!path.empty() && path[0] != '/' && getcwd(resolved, sizeof(resolved)) != nullptr)
+        {
+            path = (strcmp(resolved, "/") == 0 ? "" : std::string(resolved)) + "/" + path;
+        }
+        
+        return entry.empty() ? path : path + "#" + entry;
+    }
+}
+
+// keeps one warm context per worker and runs jobs received over a unix socket
+template<typename Context>
+int serve(ToolDriver<Context> &tool, const CommandOptions &options)
+{
+    sockaddr_un addr;
+    if (!driver::address(options.serve, addr))
+    {
+        fprintf(stderr, "[E] socket path too long: %s\n", options.serve.c_str());
+        return 3;
+    }
+    
+    auto fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    unlink(options.serve.c_str());
+    if (fd < 0 || bind(fd, (sockaddr *)&addr, sizeof(addr)) != 0 || listen(fd, 64) != 0)
+    {
+        fprintf(stderr, "[E] unable to listen on %s: %s\n", options.serve.c_str(), strerror(errno));
+        return 3;
+    }
+    
+    driver::__socket = options.serve;
+    signal(SIGPIPE, SIG_IGN);
+    signal(SIGINT, driver::terminate);
+    signal(SIGTERM, driver::terminate);
+    
+    BuildCache cache(options, tool.name, tool.version);
+    MemoryBudget budget(options.memory);
+    WorkerPool<Context> pool(options.jobs, tool.create, tool.destroy);
+    printf("[serve] %s %s on %s with %d workers\n", tool.name.c_str(), tool.version.c_str(), options.serve.c_str(), options.jobs);
+    fflush(stdout);
+    
+    // connection threads refer to the cache, budget and pool above, all of them are joined before those go away
+    std::list<std::pair<std::thread, std::shared_ptr<driver::Connection>>> connections;
+    while (true)
+    {
+        auto client = accept(fd, nullptr, nullptr);
+        if (client < 0)
+        {
+            if (errno == EINTR || errno == ECONNABORTED) { continue; }
+            break;
+        }
+        
+        for (auto iter = connections.begin(); iter != connections.end();)
+        {
+            if (!iter->second->closed) { ++iter; continue; }
+            iter->first.join();
+            iter = connections.erase(iter);
+        }
+        
+        auto connection = std::make_shared<driver::Connection>();
+        connection->fd = client;
+        std::thread thread([&tool, &options, &cache, &budget, &pool, connection]
+        {
+            driver::LineReader reader(connection->fd);
+            std::string line;
+            while (reader.next(line))
+            {
+                line = driver::trim(line);
+                if (line.empty()) { continue; }
+                
+                Json request;
+                ArgumentOptions args("");
+                auto valid = driver::job(line, request, args);
+                args.inherit(options.defaults);
+                auto id = valid && request.find("id") != nullptr ? *request.find("id") : Json();
+                auto name = valid && request.find("tool") != nullptr ? request.find("tool")->text : tool.name;
+                if (!valid || name != tool.name)
+                {
+                    auto reply = driver::error(id, valid ? "tool mismatch, server runs " + tool.name : "malformed request");
+                    std::lock_guard<std::mutex> lock(connection->mutex);
+                    driver::send(connection->fd, reply.dump() + "\n");
+                    continue;
+                }
+                
+                {
+                    std::lock_guard<std::mutex> lock(connection->mutex);
+                    ++connection->pending;
+                }
+                
+                pool.submit([&tool, &cache, &budget, connection, id, args](Context *context) mutable
+                {
+                    auto reply = driver::execute(tool, cache, budget, context, args);
+                    reply.members.insert(reply.members.begin(), std::make_pair(std::string("id"), id));
+                    
+                    std::lock_guard<std::mutex> lock(connection->mutex);
+                    driver::send(connection->fd, reply.dump() + "\n");
+                    --connection->pending;
+                    connection->condition.notify_all();
+                });
+            }
+            
+            std::unique_lock<std::mutex> lock(connection->mutex);
+            connection->condition.wait(lock, [&]{ return connection->pending == 0; });
+            close(connection->fd);
+            connection->closed = true;
+        });
+        connections.emplace_back(std::move(thread), connection);
+    }
+    
+    for (auto iter = connections.begin(); iter != connections.end(); iter++) { iter->first.join(); }
+    close(fd);
+    unlink(options.serve.c_str());
+    return 0;
+}
+
+// thin client: sends the command line jobs to a server and prints results as if they ran locally
+template<typename Context>
+int forward(ToolDriver<Context> &tool, const CommandOptions &options)
+{
+    sockaddr_un addr;
+    auto fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0 || !driver::address(options.connect, addr) || connect(fd, (sockaddr *)&addr, sizeof(addr)) != 0)
+    {
+        fprintf(stderr, "[E] unable to connect to %s: %s\n", options.connect.c_str(), strerror(errno));
+        return 3;
+    }
+    signal(SIGPIPE, SIG_IGN);
+    
+    auto count = static_cast<int>(options.files.size());
+    std::vector<ArgumentOptions> jobs;
+    std::string requests;
+    for (auto i = 0; i < count; i++)
+    {
+        jobs.emplace_back(options.files[i]);
+        auto &args = jobs.back();
+        args.inherit(options.defaults);
+        
+        auto params = Json::object();
+        for (auto iter = args.data.begin(); iter != args.data.end(); iter++) { params.set(iter->first, iter->second); }
+        
+        auto request = Json::object();
+        request.set("id", i);
+        request.set("tool", tool.name);
+        request.set("file", driver::absolute(args.filename));
+        request.set("options", params);
+        requests += request.dump() + "\n";
+    }
+    
+    std::thread sender([&]
+    {
+        driver::send(fd, requests);
+        shutdown(fd, SHUT_WR);
+    });
+    
+    std::vector<Json> results(count);
+    std::vector<bool> received(count, false);
+    auto next = 0, failures = 0;
+    driver::LineReader reader(fd);
+    std::string line;
+    while (next < count && reader.next(line))
+    {
+        Json reply;
+        if (!Json::parse(line, reply)) { continue; }
+        auto id = reply.find("id");
+        if (id == nullptr || id->type != Json::eNumber || id->number < 0 || id->number >= count)
+        {
+            auto error = reply.find("error");
+            fprintf(stderr, "[E] %s\n", error != nullptr ? error->text.c_str() : line.c_str());
+            continue;
+        }
+        
+        auto index = (int)id->number;
+        results[index] = reply;
+        received[index] = true;
+        
+        while (next < count && received[next])
+        {
+            auto &result = results[next];
+            auto &args = jobs[next];
+            if (tool.announce) { tool.announce(args, next, count); }
+            
+            auto log = result.find("log");
+            if (log != nullptr) { output(log->text); }
+            
+            auto status = result.find("status");
+            if (status == nullptr || status->text != "ok")
+            {
+                auto error = result.find("error");
+                if (error != nullptr) { fprintf(stderr, "[E] %s %s\n", args.filename.c_str(), error->text.c_str()); }
+                ++failures;
+            }
+            
+            JobRecord record;
+            driver::record(result, record);
+            if (tool.finished) { tool.finished(next, args, record); }
+            
+            result = Json();
+            ++next;
+        }
+    }
+    
+    sender.join();
+    close(fd);
+    
+    if (next < count)
+    {
+        fprintf(stderr, "[E] connection closed with %d jobs unfinished\n", count - next);
+        failures += count - next;
+    }
+    
+    return failures == 0 ? 0 : 2;
+}
+
+// runs jobs listed in a file or stdin as they are read, streams a JSON result line per job as it finishes
+template<typename Context>
+int manifest(ToolDriver<Context> &tool, const CommandOptions &options)
+{
+    auto fd = options.manifest == "-" ? STDIN_FILENO : open(options.manifest.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        fprintf(stderr, "[E] unable to open manifest %s: %s\n", options.manifest.c_str(), strerror(errno));
+        return 3;
+    }
+    
+    BuildCache cache(options, tool.name, tool.version);
+    MemoryBudget budget(options.memory);
+    std::mutex mutex;
+    auto failures = 0;
+    auto emit = [&](const Json &result)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto status = result.find("status");
+        if (status == nullptr || status->text != "ok") { ++failures; }
+        
+        auto line = result.dump() + "\n";
+        fwrite(line.data(), 1, line.size(), stdout);
+        fflush(stdout);
+    };
+    
+    {
+        WorkerPool<Context> pool(options.jobs, tool.create, tool.destroy);
+        driver::LineReader reader(fd);
+        std::string line;
+        auto index = 0;
+        while (reader.next(line))
+        {
+            line = driver::trim(line);
+            if (line.empty() || line[0] == '#') { continue; }
+            
+            Json request;
+            ArgumentOptions args("");
+            auto valid = driver::job(line, request, args);
+            args.inherit(options.defaults);
+            auto id = valid && request.find("id") != nullptr ? *request.find("id") : Json(index);
+            ++index;
+            
+            if (!valid)
+            {
+                emit(driver::error(id, "malformed job: " + line));
+                continue;
+            }
+            
+            pool.submit([&, id, args](Context *context) mutable
+            {
+                auto result = driver::execute(tool, cache, budget, context, args);
+                result.members.insert(result.members.begin(), std::make_pair(std::string("id"), id));
+                emit(result);
+            });
+        }
+        pool.join();
+    }
+    
+    if (fd != STDIN_FILENO) { close(fd); }
+    
+    // stdout carries the JSON-lines results
+    cache.evict(stderr);
+    cache.report(stderr);
+    
+    return failures == 0 ? 0 : 2;
+}
+
+// command line entry shared by all tools: batch, --serve, --connect or --manifest
+template<typename Context>
+int drive(ToolDriver<Context> &tool, const CommandOptions &options)
+{
+    if (!options.serve.empty()) { return serve(tool, options); }
+    if (!options.manifest.empty()) { return manifest(tool, options); }
+    if (options.files.empty()) { return 1; }
+    if (!options.connect.empty()) { return forward(tool, options); }
+    
+    BuildCache cache(options, tool.name, tool.version);
+    MemoryBudget budget(options.memory);
+    auto count = static_cast<int>(options.files.size());
+    auto failures = dispatch<Context>(options.jobs, count, tool.create, tool.destroy, [&](Context *context, int i)
+    {
+        ArgumentOptions args(options.files[i]);
+        args.inherit(options.defaults);
+        if (tool.announce) { tool.announce(args, i, count); }
+        
+        JobRecord record;
+        auto success = driver::run(tool, cache, budget, context, args, record);
+        if (tool.finished) { tool.finished(i, args, record); }
+        return success;
+    });
+    
+    cache.evict();
+    cache.report();
+    
+    return failures == 0 ? 0 : 2;
+}
+
+#endif /* driver_h */
@@ -0,0 +1,654 @@
+//
+//  fbxascii.h
+//  fbxtools
+//
+//  Created by LARRYHOU on 2026/10/19.
+//  Copyright © 2026 LARRYHOU. All rights reserved.
+//
+
+#ifndef fbxascii_h
+#define fbxascii_h
+
+#include <algorithm>
+#include <set>
+#include <string>
+#include <vector>
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <archive.h>
+#include <workers.h>
+#include <fbxbinary.h>
+
+namespace fbxascii
+{
+    // powers of ten a double holds exactly
+    const double powers[] = {
+        1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+    };
+    
+    // same FileId, CreationTime and footer id as fbxgen writes, the SDK checks them as a set
+    const char fileId[] = "\x28\xb3\x2a\xeb\xb6\x24\xcc\xc2\xbf\xc8\xb0\x2a\xa9\x2b\xfc\xf1";
+    const char footerId[] = "\xfa\xbc\xab\x09\xd0\xc8\xd4\x66\xb1\x76\xfb\x83\x1c\xf7\x26\x7e";
+    const char creationTime[] = "1970-01-01 10:00:00:000";
+    
+    inline bool blank(char c) { return c == ' ' || c == '\t' || c == '\r'; }
+    inline bool space(char c) { return blank(c) || c == '\n'; }
+    inline bool digit(char c) { return c >= '0' && c <= '9'; }
+    inline bool delimiter(char c) { return space(c) || c == ',' || c == '{' || c == '}' || c == ';'; }
+    
+    // nan, nan(...), inf and infinity in any case as printf writes them, numbers even without a sign or digit in front
+    inline bool special(const char *p, const char *end)
+    {
+        auto q = p;
+        while (q < end && !delimiter(*q)) { q++; }
+        auto size = q - p;
+        if (size >= 4 && strncasecmp(p, "nan(", 4) == 0) { return true; }
+        if (size == 3) { return strncasecmp(p, "nan", 3) == 0 || strncasecmp(p, "inf", 3) == 0; }
+        return size == 8 && strncasecmp(p, "infinity", 8) == 0;
+    }
+    
+    // number token at p, integers stay exact and reals whose mantissa fits 53 bits with a power of ten
+    // up to 22 are computed exactly with one multiplication or division, anything else goes to strtod
+    const char *number(const char *p, const char *end, bool &integer, int64_t &i, double &d)
+    {
+        auto start = p;
+        auto negative = false;
+        if (p < end && (*p == '-' || *p == '+')) { negative = *p++ == '-'; }
+        
+        uint64_t mantissa = 0;
+        auto digits = 0, exponent = 0;
+        auto exact = true;
+        for (; p < end && digit(*p); p++)
+        {
+            if (digits < 19) { mantissa = mantissa * 10 + (*p - '0'); }
+            else { exponent++; exact = false; }
+            if (mantissa > 0) { digits++; }
+        }
+        
+        integer = true;
+        if (p < end && *p == '.')
+        {
+            integer = false;
+            for (p++; p < end && digit(*p); p++)
+            {
+                if (digits >= 19) { exact = false; continue; }
+                mantissa = mantissa * 10 + (*p - '0');
+                exponent--;
+                if (mantissa > 0) { digits++; }
+            }
+        }
+        
+        if (p < end && (*p == 'e' || *p == 'E'))
+        {
+            integer = false;
+            auto sign = 1, power = 0;
+            if (++p < end && (*p == '-' || *p == '+')) { sign = *p++ == '-' ? -1 : 1; }
+            for (; p < end && digit(*p); p++) { power = std::min(power * 10 + (*p - '0'), 100000); }
+            exponent += sign * power;
+        }
+        
+        if (p == start || (p < end && !delimiter(*p)))
+        { // 1.#INF, -1.#IND and friends of msvc, nan and inf
+            while (p < end && !delimiter(*p)) { p++; }
+            integer = false;
+            exact = false;
+            if (memchr(start, '#', p - start) != nullptr)
+            {
+                auto infinite = memchr(start, 'F', p - start) != nullptr;
+                d = infinite ? (*start == '-' ? -HUGE_VAL : HUGE_VAL) : NAN;
+                return p;
+            }
+        }
+        
+        if (integer && exact && mantissa <= (uint64_t)INT64_MAX)
+        {
+            i = negative ? -(int64_t)mantissa : (int64_t)mantissa;
+            d = (double)i;
+            return p;
+        }
+        
+        integer = false;
+        if (exact && mantissa < (1ULL << 53) && exponent >= -22 && exponent <= 22)
+        {
+            d = (double)mantissa;
+            d = exponent < 0 ? d / powers[-exponent] : d * powers[exponent];
+            if (negative) { d = -d; }
+            return p;
+        }
+        
+        char buffer[128];
+        auto size = std::min((size_t)(p - start), sizeof(buffer) - 1);
+        memcpy(buffer, start, size);
+        buffer[size] = 0;
+        d = strtod(buffer, nullptr);
+        return p;
+    }
+    
+    // text of Video/Content, may be split into several strings
+    bool base64(const std::string &text, std::vector<char> &output)
+    {
+        static int8_t table[256];
+        static bool ready = false;
+        if (!ready)
+        {
+            const char *alphabet = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+            memset(table, -1, sizeof(table));
+            for (auto i = 0; i < 64; i++) { table[(uint8_t)alphabet[i]] = i; }
+            ready = true;
+        }
+        
+        output.clear();
+        output.reserve(text.size() / 4 * 3);
+        uint32_t bits = 0;
+        auto count = 0;
+        for (auto iter = text.begin(); iter != text.end(); iter++)
+        {
+            auto c = (uint8_t)*iter;
+            if (c == '=') { break; }
+            if (space(c)) { continue; }
+            if (table[c] < 0) { return false; }
+            bits = bits << 6 | table[c];
+            if (++count == 4)
+            {
+                output.push_back((char)(bits >> 16));
+                output.push_back((char)(bits >> 8));
+                output.push_back((char)bits);
+                bits = 0;
+                count = 0;
+            }
+        }
+        
+        if (count == 1) { return false; }
+        if (count == 2) { output.push_back((char)(bits >> 4)); }
+        if (count == 3)
+        {
+            output.push_back((char)(bits >> 10));
+            output.push_back((char)(bits >> 2));
+        }
+        return true;
+    }
+}
+
+// ASCII FBX 7.x turned into the binary records the SDK would write for the same scene, without the SDK
+// ASCII doesn't tell int from long from double, types come from record names and Properties70 types
+class AsciiDocument
+{
+    struct Value
+    {
+        char type = 0; // I, L, D, C, S or A for an array
+        int64_t integer = 0;
+        double real = 0;
+        std::string text;
+        int array = -1;
+    };
+    
+    struct Array
+    {
+        char type = 'd';
+        uint32_t count = 0;
+        const char *begin = nullptr;
+        const char *end = nullptr;
+        
+        uint32_t encoding = 0;
+        std::vector<char> data; // stored form
+        bool success = false;
+        bool bits = false; // float array written as int32 bit patterns, KeyAttrDataFloat
+    };
+    
+    struct Record
+    {
+        std::string name;
+        int depth = 0;
+        size_t first = 0; // values
+        size_t count = 0;
+    };
+    
+    MappedSource __source;
+    const char *__data = nullptr;
+    const char *__end = nullptr;
+    const char *__p = nullptr;
+    uint32_t __version = 0;
+    std::string __error;
+    
+    std::vector<Record> __records;
+    std::vector<Value> __values;
+    std::vector<Array> __arrays;
+    
+    bool fail(const char *message, const char *position)
+    {
+        auto line = 1 + std::count(__data, std::min(position, __end), '\n');
+        __error = std::string(message) + " at line " + std::to_string(line);
+        return false;
+    }
+    
+    // whitespace and ; comments
+    void skip()
+    {
+        while (__p < __end)
+        {
+            if (fbxascii::space(*__p)) { __p++; continue; }
+            if (*__p != ';') { return; }
+            auto eol = static_cast<const char *>(memchr(__p, '\n', __end - __p));
+            __p = eol == nullptr ? __end : eol + 1;
+        }
+    }
+    
+    // element type of arrays, the rest are doubles
+    static char element(const std::string &name)
+    {
+        static const std::set<std::string> integers = {
+            "PolygonVertexIndex", "Edges", "Materials", "Smoothing", "Indexes", "TextureId",
+            "NormalsIndex", "BinormalsIndex", "TangentsIndex", "UVIndex", "ColorIndex", "PolygonGroup",
+            "KeyAttrFlags", "KeyAttrRefCount", "Multiplicity", "MultiplicityU", "MultiplicityV", "PointsIndex"
+        };
+        if (integers.count(name)) { return 'i'; }
+        if (name == "KeyValueFloat" || name == "KeyAttrDataFloat") { return 'f'; }
+        if (name == "KeyTime") { return 'l'; }
+        return 'd';
+    }
+    
+    // type of a number property, values of P follow the property type at index 1
+    static char scalar(const std::vector<std::string> &stack, const std::string &name, size_t index, const Value *ptype, bool integer, int64_t value)
+    {
+        static const std::set<std::string> ints = {"int", "Integer", "enum", "bool", "Bool", "Visibility Inheritance"};
+        static const std::set<std::string> longs = {"KTime", "ULongLong", "LongLong"};
+        static const std::set<std::string> reals = {"Default", "Link_DeformAcuracy", "DeformPercent"};
+        static const std::set<std::string> times = {"RootNode", "LocalTime", "ReferenceTime"};
+        
+        if (name == "P" && index >= 4 && ptype != nullptr)
+        {
+            if (ints.count(ptype->text)) { return 'I'; }
+            if (longs.count(ptype->text)) { return 'L'; }
+            return 'D';
+        }
+        
+        if (!integer || reals.count(name)) { return 'D'; }
+        if (value < INT32_MIN || value > INT32_MAX || times.count(name)) { return 'L'; }
+        
+        // object ids and the ids connections refer to
+        auto parent = stack.empty() ? std::string() : stack.back();
+        if (index == 0 && (parent == "Objects" || name == "Document")) { return 'L'; }
+        if (index >= 1 && name == "C") { return 'L'; }
+        return 'I';
+    }
+    
+    // SDK decodes these entities of quoted text
+    static void unescape(std::string &text)
+    {
+        if (text.find('&') == std::string::npos) { return; }
+        
+        static const char *entities[][2] = {{"&quot;", "\""}, {"&lf;", "\n"}, {"&cr;", "\r"}};
+        for (auto i = 0; i < 3; i++)
+        {
+            auto length = strlen(entities[i][0]);
+            for (auto pos = text.find(entities[i][0]); pos != std::string::npos; pos = text.find(entities[i][0], pos + 1))
+            {
+                text.replace(pos, length, entities[i][1]);
+            }
+        }
+    }
+    
+    // "Class::Name" of ASCII object names is "Name\0\x01Class" in binary
+    static void rename(std::string &text)
+    {
+        auto pos = text.find("::");
+        if (pos == std::string::npos) { return; }
+        text = text.substr(pos + 2) + std::string("\0\x01", 2) + text.substr(0, pos);
+    }
+    
+    bool array(Value &value, const std::string &name)
+    {
+        int64_t count = 0;
+        double real;
+        bool integer;
+        auto start = __p;
+        __p = fbxascii::number(__p + 1, __end, integer, count, real);
+        if (!integer || count < 0 || count > UINT32_MAX) { return fail("bad array size", start); }
+        
+        skip();
+        if (__p >= __end || *__p != '{') { return fail("expected {", __p); }
+        ++__p;
+        skip();
+        if (__end - __p < 2 || __p[0] != 'a' || __p[1] != ':') { return fail("expected a:", __p); }
+        __p += 2;
+        
+        // numbers, commas and whitespace only, memchr finds the end at memory speed
+        auto close = static_cast<const char *>(memchr(__p, '}', __end - __p));
+        if (close == nullptr) { return fail("unterminated array", start); }
+        
+        Array item;
+        item.type = element(name);
+        item.bits = name == "KeyAttrDataFloat";
+        item.count = (uint32_t)count;
+        item.begin = __p;
+        item.end = close;
+        value.type = 'A';
+        value.array = (int)__arrays.size();
+        __arrays.push_back(item);
+        __p = close + 1;
+        return true;
+    }
+    
+    bool values(Record &record, const std::vector<std::string> &stack)
+    {
+        size_t index = 0;
+        while (true)
+        {
+            while (__p < __end && fbxascii::blank(*__p)) { __p++; }
+            if (__p >= __end || *__p == '\n' || *__p == '{' || *__p == '}' || *__p == ';') { return true; }
+            if (*__p == ',')
+            { // empty value, eg. Content: ,
+                ++__p;
+                skip();
+                continue;
+            }
+            
+            Value value;
+            auto c = *__p;
+            if (c == '"')
+            {
+                auto close = static_cast<const char *>(memchr(__p + 1, '"', __end - __p - 1));
+                if (close == nullptr) { return fail("unterminated string", __p); }
+                value.type = 'S';
+                value.text.assign(__p + 1, close);
+                unescape(value.text);
+                if (index == 1 && !stack.empty() && stack.back() == "Objects") { rename(value.text); }
+                __p = close + 1;
+            }
+            else if (c == '*')
+            {
+                if (!array(value, record.name)) { return false; }
+            }
+            else if (fbxascii::digit(c) || c == '-' || c == '+' || c == '.' || fbxascii::special(__p, __end))
+            {
+                bool integer;
+                __p = fbxascii::number(__p, __end, integer, value.integer, value.real);
+                auto ptype = index >= 4 ? &__values[record.first + 1] : nullptr;
+                value.type = scalar(stack, record.name, index, ptype, integer, value.integer);
+            }
+            else
+            { // T, F, Y, N and other single letters are chars, Shading: T
+                auto start = __p;
+                while (__p < __end && !fbxascii::delimiter(*__p)) { __p++; }
+                std::string word(start, __p);
+                if (word.size() == 1)
+                {
+                    value.type = 'C';
+                    value.integer = c == 'T' || c == 'Y' ? 1 : (c == 'F' || c == 'N' ? 0 : c);
+                }
+                else
+                {
+                    value.type = 'S';
+                    value.text = word;
+                }
+            }
+            
+            __values.push_back(value);
+            index++;
+            
+            while (__p < __end && fbxascii::blank(*__p)) { __p++; }
+            if (__p >= __end || *__p != ',') { return true; }
+            ++__p;
+            skip();
+        }
+    }
+    
+    bool scan()
+    {
+        __p = __data;
+        std::vector<std::string> stack;
+        while (true)
+        {
+            skip();
+            if (__p >= __end) { break; }
+            if (*__p == '}')
+            {
+                if (stack.empty()) { return fail("unexpected }", __p); }
+                stack.pop_back();
+                ++__p;
+                continue;
+            }
+            
+            auto start = __p;
+            while (__p < __end && *__p != ':' && !fbxascii::delimiter(*__p)) { __p++; }
+            if (__p >= __end || *__p != ':' || __p == start) { return fail("expected record name", start); }
+            
+            Record record;
+            record.name.assign(start, __p++);
+            record.depth = (int)stack.size();
+            record.first = __values.size();
+            if (!values(record, stack)) { return false; }
+            record.count = __values.size() - record.first;
+            
+            if (record.name == "FBXVersion" && record.count > 0 && stack.size() == 1) { __version = (uint32_t)__values[record.first].integer; }
+            __records.push_back(record);
+            
+            while (__p < __end && fbxascii::blank(*__p)) { __p++; }
+            if (__p < __end && *__p == '{')
+            {
+                stack.push_back(record.name);
+                ++__p;
+            }
+        }
+        
+        return stack.empty() || fail("unexpected end", __end);
+    }
+    
+    // text of array items into its binary element type
+    template<typename T>
+    static bool decode(Array &item)
+    {
+        item.data.resize(item.count * sizeof(T));
+        auto data = reinterpret_cast<T *>(item.data.data());
+        auto p = item.begin;
+        uint32_t n = 0;
+        while (true)
+        {
+            while (p < item.end && (fbxascii::space(*p) || *p == ',')) { p++; }
+            if (p >= item.end) { break; }
+            if (n >= item.count) { return false; }
+            
+            bool integer;
+            int64_t i;
+            double d;
+            auto next = fbxascii::number(p, item.end, integer, i, d);
+            if (next == p) { return false; }
+            data[n++] = integer ? static_cast<T>(i) : static_cast<T>(d);
+            p = next;
+        }
+        return n == item.count;
+    }
+    
+    static void decode(Array &item, int level, size_t threshold)
+    {
+        switch (item.type)
+        {
+            case 'i': item.success = decode<int32_t>(item); break;
+            case 'l': item.success = decode<int64_t>(item); break;
+            case 'f': item.success = item.bits ? decode<int32_t>(item) : decode<float>(item); break; // same 4 bytes either way
+            default: item.success = decode<double>(item); break;
+        }
+        
+        std::vector<char> compressed;
+        if (item.success && level > 0 && item.data.size() >= threshold && fbxbinary::deflate(item.data.data(), item.data.size(), level, compressed))
+        {
+            item.data.swap(compressed);
+            item.encoding = 1;
+        }
+    }
+    
+    void write(BinaryRecordWriter &w, const Record &record)
+    {
+        w.begin(record.name);
+        if (record.name == "Content")
+        { // base64 text of embedded media is raw bytes in binary
+            std::string text;
+            for (auto i = record.first; i < record.first + record.count; i++) { text += __values[i].text; }
+            std::vector<char> bytes;
+            if (fbxascii::base64(text, bytes))
+            {
+                w.raw(bytes.data(), bytes.size());
+                return;
+            }
+        }
+        
+        for (auto i = record.first; i < record.first + record.count; i++)
+        {
+            auto &value = __values[i];
+            switch (value.type)
+            {
+                case 'I': w.add((int32_t)value.integer); break;
+                case 'L': w.add(value.integer); break;
+                case 'D': w.add(value.real); break;
+                case 'C': w.add((bool)value.integer); break;
+                case 'S': w.add(value.text); break;
+                case 'A':
+                {
+                    auto &item = __arrays[value.array];
+                    w.array(item.type, item.count, item.encoding, item.data.data(), item.data.size());
+                    std::vector<char>().swap(item.data);
+                    break;
+                }
+            }
+        }
+    }
+
+public:
+    uint32_t version() const { return __version; }
+    size_t arrays() const { return __arrays.size(); }
+    
+    bool open(const std::string &spec, std::string &error)
+    {
+        if (!__source.open(spec))
+        {
+            error = "unable to read";
+            return false;
+        }
+        
+        __data = __source.data();
+        __end = __data + __source.size();
+        if (__source.size() >= 23 && memcmp(__data, fbxbinary::magic, 23) == 0)
+        {
+            error = "already a binary FBX";
+            return false;
+        }
+        return true;
+    }
+    
+    // records and values, array text is only located here
+    bool parse(std::string &error)
+    {
+        if (!scan())
+        {
+            error = __error;
+            return false;
+        }
+        
+        if (__version == 0) { __version = 7400; }
+        if (__version < 7000 || __version >= 8000)
+        {
+            error = "unsupported FBX version " + std::to_string(__version);
+            return false;
+        }
+        return true;
+    }
+    
+    // arrays are parsed and compressed on worker threads, largest first
+    bool decode(int threads, int level, size_t threshold, std::string &error)
+    {
+        if (threads > 1 && __arrays.size() > 1)
+        {
+            std::vector<size_t> order(__arrays.size());
+            for (size_t i = 0; i < order.size(); i++) { order[i] = i; }
+            std::sort(order.begin(), order.end(), [&](size_t a, size_t b) { return __arrays[a].end - __arrays[a].begin > __arrays[b].end - __arrays[b].begin; });
+            
+            WorkerPool<void> pool(std::min(threads, (int)__arrays.size()));
+            for (auto iter = order.begin(); iter != order.end(); iter++)
+            {
+                auto &item = __arrays[*iter];
+                pool.submit([&item, level, threshold](void *) { decode(item, level, threshold); });
+            }
+            pool.join();
+        }
+        else
+        {
+            for (auto iter = __arrays.begin(); iter != __arrays.end(); iter++) { decode(*iter, level, threshold); }
+        }
+        
+        for (auto iter = __arrays.begin(); iter != __arrays.end(); iter++)
+        {
+            if (iter->success) { continue; }
+            fail("bad array", iter->begin);
+            error = __error;
+            return false;
+        }
+        return true;
+    }
+    
+    // FileId and CreationTime are replaced by a pair the SDK accepts together with the footer
+    bool write(const std::string &filename, std::string &error)
+    {
+        BinaryWriter writer;
+        if (!writer.open(filename))
+        {
+            error = "unable to write";
+            return false;
+        }
+        
+        BinaryRecordWriter w(writer, __version);
+        w.header();
+        
+        auto depth = 0, skipping = -1;
+        auto identified = false;
+        for (auto iter = __records.begin(); iter != __records.end(); iter++)
+        {
+            if (skipping >= 0 && iter->depth > skipping) { continue; }
+            skipping = -1;
+            for (; depth > iter->depth; depth--) { w.end(); }
+            
+            if (iter->depth == 0)
+            {
+                if (iter->name == "FileId" || iter->name == "CreationTime")
+                {
+                    skipping = 0;
+                    continue;
+                }
+                
+                if (!identified && iter->name != "FBXHeaderExtension")
+                {
+                    w.begin("FileId");
+                    w.raw(fbxascii::fileId, 16);
+                    w.end();
+                    w.record("CreationTime", fbxascii::creationTime);
+                    identified = true;
+                }
+            }
+            
+            write(w, *iter);
+            depth = iter->depth + 1;
+        }
+        
+        for (; depth > 0; depth--) { w.end(); }
+        if (!identified)
+        {
+            w.begin("FileId");
+            w.raw(fbxascii::fileId, 16);
+            w.end();
+            w.record("CreationTime", fbxascii::creationTime);
+        }
+        
+        w.footer(fbxascii::footerId);
+        if (!writer.close())
+        {
+            error = "unable to write";
+            return false;
+        }
+        return true;
+    }
+};
+
+#endif /* fbxascii_h */
@@ -0,0 +1,972 @@
+//
+//  fbxbinary.h
+//  fbxtools
+//
+//  Created by LARRYHOU on 2026/10/19.
+//  Copyright © 2026 LARRYHOU. All rights reserved.
+//
+
+#ifndef fbxbinary_h
+#define fbxbinary_h
+
+#include <algorithm>
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <zlib.h>
+
+#include <archive.h>
+#include <workers.h>
+
+// reader of binary FBX 7.x node records straight from the file bytes, no FBX SDK involved
+// layout: 27 byte header, then records of
+//   end offset, property count, property bytes (uint32 before 7500, uint64 since), name length (uint8), name
+//   properties, nested records closed by a null record
+namespace fbxbinary
+{
+    const char magic[] = "Kaydara FBX Binary  \0\x1a\0";
+    const size_t header = 27;
+    
+    template<typename T>
+    T read(const char *p)
+    {
+        T v;
+        memcpy(&v, p, sizeof(T)); // FBX is little endian as every platform we build on
+        return v;
+    }
+}
+
+struct BinaryProperty
+{
+    char type = 0;
+    const char *data = nullptr; // payload, after array or string header
+    uint32_t length = 0;        // elements of arrays, bytes of strings and raw data
+    uint32_t encoding = 0;      // arrays only, 1 for zlib
+    uint32_t size = 0;          // payload bytes in file
+    
+    bool array() const { return type == 'f' || type == 'd' || type == 'l' || type == 'i' || type == 'b'; }
+    
+    int64_t integer() const
+    {
+        switch (type)
+        {
+            case 'C': return data[0];
+            case 'Y': return fbxbinary::read<int16_t>(data);
+            case 'I': return fbxbinary::read<int32_t>(data);
+            case 'L': return fbxbinary::read<int64_t>(data);
+            case 'F': return (int64_t)fbxbinary::read<float>(data);
+            case 'D': return (int64_t)fbxbinary::read<double>(data);
+            default: return 0;
+        }
+    }
+    
+    double real() const
+    {
+        switch (type)
+        {
+            case 'F': return fbxbinary::read<float>(data);
+            case 'D': return fbxbinary::read<double>(data);
+            default: return (double)integer();
+        }
+    }
+    
+    std::string string() const
+    {
+        return type == 'S' || type == 'R' ? std::string(data, length) : std::string();
+    }
+    
+    // bytes of array elements as stored in file after inflating
+    bool bytes(std::vector<char> &out) const
+    {
+        if (!array()) { return false; }
+        
+        size_t stride = type == 'd' || type == 'l' ? 8 : (type == 'b' ? 1 : 4);
+        out.resize(stride * length);
+        if (encoding == 0)
+        {
+            if (size != out.size()) { return false; }
+            memcpy(out.data(), data, size);
+            return true;
+        }
+        
+        uLongf count = out.size();
+        return encoding == 1 && uncompress((Bytef *)out.data(), &count, (const Bytef *)data, size) == Z_OK && count == out.size();
+    }
+    
+    template<typename T>
+    bool values(std::vector<T> &out) const
+    {
+        std::vector<char> buffer;
+        if (!bytes(buffer)) { return false; }
+        
+        out.resize(length);
+        auto ptr = buffer.data();
+        for (uint32_t i = 0; i < length; i++)
+        {
+            switch (type)
+            {
+                case 'f': out[i] = (T)fbxbinary::read<float>(ptr + i * 4); break;
+                case 'd': out[i] = (T)fbxbinary::read<double>(ptr + i * 8); break;
+                case 'l': out[i] = (T)fbxbinary::read<int64_t>(ptr + i * 8); break;
+                case 'i': out[i] = (T)fbxbinary::read<int32_t>(ptr + i * 4); break;
+                case 'b': out[i] = (T)ptr[i]; break;
+            }
+        }
+        return true;
+    }
+};
+
+struct BinaryRecord
+{
+    uint64_t offset = 0; // first byte of record header
+    uint64_t end = 0;    // one past the last byte of the record, nested records included
+    uint64_t properties = 0;
+    uint64_t propertyBytes = 0;
+    uint32_t propertyCount = 0;
+    uint64_t children = 0; // first nested record
+    const char *name = nullptr;
+    uint8_t nameLength = 0;
+    
+    bool is(const char *label) const
+    {
+        return strlen(label) == nameLength && memcmp(name, label, nameLength) == 0;
+    }
+    
+    std::string label() const { return std::string(name, nameLength); }
+};
+
+class BinaryDocument
+{
+    MappedSource __source;
+    const char *__data = nullptr;
+    size_t __size = 0;
+    uint32_t __version = 0;
+    
+    bool record(uint64_t offset, BinaryRecord &record) const
+    {
+        auto wide = __version >= 7500;
+        auto fields = headerSize();
+        if (offset + fields > __size) { return false; }
+        
+        auto p = __data + offset;
+        if (wide)
+        {
+            record.end = fbxbinary::read<uint64_t>(p);
+            record.propertyCount = (uint32_t)fbxbinary::read<uint64_t>(p + 8);
+            record.propertyBytes = fbxbinary::read<uint64_t>(p + 16);
+        }
+        else
+        {
+            record.end = fbxbinary::read<uint32_t>(p);
+            record.propertyCount = fbxbinary::read<uint32_t>(p + 4);
+            record.propertyBytes = fbxbinary::read<uint32_t>(p + 8);
+        }
+        
+        record.offset = offset;
+        record.nameLength = (uint8_t)p[fields - 1];
+        record.name = p + fields;
+        record.properties = offset + fields + record.nameLength;
+        record.children = record.properties + record.propertyBytes;
+        return record.end == 0 || (record.end <= __size && record.children <= record.end);
+    }
+
+public:
+    BinaryDocument() {}
+    BinaryDocument(const BinaryDocument &) = delete;
+    
+    uint32_t version() const { return __version; }
+    size_t headerSize() const { return __version >= 7500 ? 25 : 13; } // record header up to the name, also size of null records
+    const char *data() const { return __data; }
+    size_t size() const { return __size; }
+    
+    // plain file or archive.zip#entry
+    bool open(const std::string &spec, std::string &error)
+    {
+        if (!__source.open(spec))
+        {
+            error = "unable to read";
+            return false;
+        }
+        
+        __data = __source.data();
+        __size = __source.size();
+        if (__size < fbxbinary::header || memcmp(__data, fbxbinary::magic, 23) != 0)
+        {
+            error = "not a binary FBX";
+            return false;
+        }
+        
+        __version = fbxbinary::read<uint32_t>(__data + 23);
+        if (__version < 7000 || __version >= 8000)
+        {
+            error = "unsupported FBX version " + std::to_string(__version);
+            return false;
+        }
+        return true;
+    }
+    
+    // sibling records in [begin, end) up to the closing null record
+    bool records(uint64_t begin, uint64_t end, std::vector<BinaryRecord> &out) const
+    {
+        out.clear();
+        auto offset = begin;
+        while (offset < end)
+        {
+            BinaryRecord item;
+            if (!record(offset, item)) { return false; }
+            if (item.end == 0) { break; }
+            out.push_back(item);
+            offset = item.end;
+        }
+        return true;
+    }
+    
+    bool roots(std::vector<BinaryRecord> &out) const { return records(fbxbinary::header, __size, out); }
+    
+    bool children(const BinaryRecord &parent, std::vector<BinaryRecord> &out) const
+    {
+        return records(parent.children, parent.end, out);
+    }
+    
+    bool properties(const BinaryRecord &record, std::vector<BinaryProperty> &out) const
+    {
+        out.clear();
+        auto p = __data + record.properties;
+        auto end = __data + record.children;
+        for (uint32_t i = 0; i < record.propertyCount; i++)
+        {
+            if (p >= end) { return false; }
+            
+            BinaryProperty item;
+            item.type = *p++;
+            switch (item.type)
+            {
+                case 'C': case 'B': item.size = 1; break;
+                case 'Y': item.size = 2; break;
+                case 'I': case 'F': item.size = 4; break;
+                case 'L': case 'D': item.size = 8; break;
+                case 'S': case 'R':
+                    if (p + 4 > end) { return false; }
+                    item.length = item.size = fbxbinary::read<uint32_t>(p);
+                    p += 4;
+                    break;
+                case 'f': case 'd': case 'l': case 'i': case 'b':
+                    if (p + 12 > end) { return false; }
+                    item.length = fbxbinary::read<uint32_t>(p);
+                    item.encoding = fbxbinary::read<uint32_t>(p + 4);
+                    item.size = fbxbinary::read<uint32_t>(p + 8);
+                    p += 12;
+                    break;
+                default: return false;
+            }
+            
+            if (p + item.size > end) { return false; }
+            item.data = p;
+            p += item.size;
+            out.push_back(item);
+        }
+        return true;
+    }
+    
+    // first child with the name, false if there is none
+    bool find(const BinaryRecord &parent, const char *name, BinaryRecord &out) const
+    {
+        std::vector<BinaryRecord> items;
+        if (!children(parent, items)) { return false; }
+        for (auto iter = items.begin(); iter != items.end(); iter++)
+        {
+            if (iter->is(name))
+            {
+                out = *iter;
+                return true;
+            }
+        }
+        return false;
+    }
+    
+    bool find(const char *name, BinaryRecord &out) const
+    {
+        std::vector<BinaryRecord> items;
+        if (!roots(items)) { return false; }
+        for (auto iter = items.begin(); iter != items.end(); iter++)
+        {
+            if (iter->is(name))
+            {
+                out = *iter;
+                return true;
+            }
+        }
+        return false;
+    }
+};
+
+namespace fbxbinary
+{
+    // object names are stored as "name\0\x01Class", the SDK only keeps the name part
+    std::string name(const BinaryProperty &property)
+    {
+        auto text = property.string();
+        auto pos = text.find(std::string("\0\x01", 2));
+        return pos == std::string::npos ? text : text.substr(0, pos);
+    }
+    
+    // value of P: "name", "type", "label", "flags", value... under Properties70
+    bool property(const BinaryDocument &document, const BinaryRecord &parent, const char *name, BinaryProperty &value)
+    {
+        BinaryRecord table;
+        std::vector<BinaryRecord> items;
+        std::vector<BinaryProperty> properties;
+        if (!document.find(parent, "Properties70", table) || !document.children(table, items)) { return false; }
+        for (auto iter = items.begin(); iter != items.end(); iter++)
+        {
+            if (!document.properties(*iter, properties) || properties.size() < 5) { continue; }
+            if (properties[0].string() == name)
+            {
+                value = properties[4];
+                return true;
+            }
+        }
+        return false;
+    }
+    
+    // first property of the named child
+    bool value(const BinaryDocument &document, const BinaryRecord &parent, const char *name, BinaryProperty &value)
+    {
+        BinaryRecord record;
+        std::vector<BinaryProperty> properties;
+        if (!document.find(parent, name, record) || !document.properties(record, properties) || properties.empty()) { return false; }
+        value = properties[0];
+        return true;
+    }
+}
+
+struct BinaryObject
+{
+    BinaryRecord record;
+    std::string name;
+    bool model = false;
+    bool attribute = false; // Geometry or NodeAttribute, what a model may hold as node attribute
+    bool mesh = false;      // Geometry of Mesh class
+    
+    int64_t parent = -1;  // model or scene root(0) a model is attached to
+    int64_t content = -1; // first attribute of a model, what GetNodeAttribute() returns
+    int64_t owner = -1;   // first model an attribute is connected to, what GetNode() returns
+    int reachable = -1;   // model is under scene root, -1 before it's known
+};
+
+// models, node attributes and geometries with the OO connections between them, records stay in the mapped file
+class BinaryScene
+{
+    std::map<int64_t, BinaryObject> __objects;
+    std::vector<int64_t> __order;
+    double __unitScaleFactor = 1;
+    
+    bool reachable(BinaryObject &model, int depth)
+    {
+        if (model.reachable >= 0) { return model.reachable != 0; }
+        if (model.parent == 0)
+        {
+            model.reachable = 1;
+            return true;
+        }
+        
+        auto iter = __objects.find(model.parent);
+        auto success = iter != __objects.end() && iter->second.model && depth < (int)__objects.size() && reachable(iter->second, depth + 1);
+        model.reachable = success ? 1 : 0;
+        return success;
+    }
+
+public:
+    std::map<int64_t, BinaryObject> &objects() { return __objects; }
+    const std::vector<int64_t> &order() const { return __order; } // objects in file order
+    double unitScaleFactor() const { return __unitScaleFactor; }
+    
+    bool load(const BinaryDocument &document)
+    {
+        BinaryRecord section;
+        std::vector<BinaryRecord> records;
+        std::vector<BinaryProperty> properties;
+        
+        BinaryProperty value;
+        if (document.find("GlobalSettings", section) && fbxbinary::property(document, section, "UnitScaleFactor", value))
+        {
+            __unitScaleFactor = value.real();
+        }
+        
+        if (!document.find("Objects", section)) { return true; }
+        if (!document.children(section, records)) { return false; }
+        for (auto iter = records.begin(); iter != records.end(); iter++)
+        {
+            auto isGeometry = iter->is("Geometry");
+            auto isModel = iter->is("Model");
+            if (!isGeometry && !isModel && !iter->is("NodeAttribute")) { continue; }
+            if (!document.properties(*iter, properties) || properties.size() < 3) { return false; }
+            
+            auto id = properties[0].integer();
+            auto &object = __objects[id];
+            object.record = *iter;
+            object.name = fbxbinary::name(properties[1]);
+            object.model = isModel;
+            object.attribute = !isModel;
+            object.mesh = isGeometry && properties[2].string() == "Mesh";
+            __order.push_back(id);
+        }
+        
+        // C: "OO", child, parent
+        if (!document.find("Connections", section)) { return true; }
+        if (!document.children(section, records)) { return false; }
+        for (auto iter = records.begin(); iter != records.end(); iter++)
+        {
+            if (!iter->is("C") || !document.properties(*iter, properties) || properties.size() < 3) { continue; }
+            if (properties[0].string() != "OO") { continue; }
+            
+            auto child = __objects.find(properties[1].integer());
+            auto parent = properties[2].integer();
+            if (child == __objects.end()) { continue; }
+            
+            auto &object = child->second;
+            if (object.model)
+            {
+                if (object.parent < 0) { object.parent = parent; }
+                continue;
+            }
+            
+            auto model = __objects.find(parent);
+            if (!object.attribute || model == __objects.end() || !model->second.model) { continue; }
+            if (object.owner < 0) { object.owner = parent; }
+            if (model->second.content < 0) { model->second.content = child->first; }
+        }
+        return true;
+    }
+    
+    bool reachable(int64_t id)
+    {
+        auto iter = __objects.find(id);
+        return iter != __objects.end() && iter->second.model && reachable(iter->second, 0);
+    }
+};
+
+// element of layer 0 as the SDK exposes it, mapping and reference hold FbxLayerElement enum values
+struct BinaryLayer
+{
+    bool valid = false;
+    int mapping = 0;
+    int reference = 0;
+    int stride = 1;
+    std::vector<double> directs;
+    std::vector<double> w; // NormalsW, TangentsW
+    std::vector<int> indices;
+};
+
+struct BinaryGeometry
+{
+    int64_t id = 0;
+    std::vector<double> points; // xyz of control points
+    std::vector<int> polygons;  // polygon sizes
+    std::vector<int> vertices;  // control point of every polygon vertex
+    
+    BinaryLayer normals;
+    BinaryLayer tangents;
+    BinaryLayer colors;
+    BinaryLayer uvs;
+};
+
+// decodes Geometry records one at a time with the arrays of a geometry inflated in parallel,
+// memory stays bounded by the largest mesh rather than by the scene
+class GeometryReader
+{
+    struct Array
+    {
+        BinaryProperty property;
+        std::vector<double> *reals = nullptr;
+        std::vector<int> *integers = nullptr;
+    };
+    
+    const BinaryDocument &__document;
+    int __threads;
+    std::vector<Array> __arrays;
+    std::vector<int> __indices; // PolygonVertexIndex
+    
+    bool collect(const BinaryRecord &parent, const char *name, std::vector<double> *reals, std::vector<int> *integers)
+    {
+        BinaryProperty property;
+        if (!fbxbinary::value(__document, parent, name, property)) { return true; }
+        if (!property.array()) { return false; }
+        
+        Array item;
+        item.property = property;
+        item.reals = reals;
+        item.integers = integers;
+        __arrays.push_back(item);
+        return true;
+    }
+    
+    std::string text(const BinaryRecord &parent, const char *name)
+    {
+        BinaryProperty property;
+        return fbxbinary::value(__document, parent, name, property) ? property.string() : std::string();
+    }
+    
+    static int mapping(const std::string &name)
+    {
+        if (name == "ByVertice" || name == "ByVertex" || name == "ByControlPoint") { return 1; }
+        if (name == "ByPolygonVertex") { return 2; }
+        if (name == "ByPolygon") { return 3; }
+        if (name == "ByEdge") { return 4; }
+        if (name == "AllSame") { return 5; }
+        return 0;
+    }
+    
+    // Index is what FBX 5 called IndexToDirect
+    static int reference(const std::string &name)
+    {
+        return name == "Index" || name == "IndexToDirect" ? 2 : 0;
+    }
+    
+    bool layer(const std::vector<BinaryRecord> &items, const std::map<std::string, int> &elements, const char *type, const char *directs, const char *w, const char *indices, int stride, BinaryLayer &layer)
+    {
+        auto match = elements.find(type);
+        if (match == elements.end()) { return true; }
+        
+        std::vector<BinaryProperty> properties;
+        for (auto iter = items.begin(); iter != items.end(); iter++)
+        {
+            if (!iter->is(type) || !__document.properties(*iter, properties) || properties.empty()) { continue; }
+            if (properties[0].integer() != match->second) { continue; }
+            
+            layer.valid = true;
+            layer.stride = stride;
+            layer.mapping = mapping(text(*iter, "MappingInformationType"));
+            layer.reference = reference(text(*iter, "ReferenceInformationType"));
+            if (!collect(*iter, directs, &layer.directs, nullptr)) { return false; }
+            if (w != nullptr && !collect(*iter, w, &layer.w, nullptr)) { return false; }
+            return layer.reference == 0 || collect(*iter, indices, nullptr, &layer.indices);
+        }
+        return true;
+    }
+
+public:
+    GeometryReader(const BinaryDocument &document, int threads = 1): __document(document), __threads(threads) {}
+    
+    bool decode(const BinaryRecord &geometry, BinaryGeometry &data)
+    {
+        std::vector<BinaryRecord> items, entries;
+        std::vector<BinaryProperty> properties;
+        if (!__document.children(geometry, items)) { return false; }
+        
+        __arrays.clear();
+        if (!collect(geometry, "Vertices", &data.points, nullptr)) { return false; }
+        if (!collect(geometry, "PolygonVertexIndex", nullptr, &__indices)) { return false; }
+        
+        // layer elements assigned to layer 0, a mesh without layers has no elements either
+        std::map<std::string, int> elements;
+        for (auto iter = items.begin(); iter != items.end(); iter++)
+        {
+            if (!iter->is("Layer") || !__document.properties(*iter, properties) || properties.empty()) { continue; }
+            if (properties[0].integer() != 0 || !__document.children(*iter, entries)) { continue; }
+            for (auto entry = entries.begin(); entry != entries.end(); entry++)
+            {
+                BinaryProperty index;
+                if (!entry->is("LayerElement") || !fbxbinary::value(__document, *entry, "TypedIndex", index)) { continue; }
+                elements[text(*entry, "Type")] = (int)index.integer();
+            }
+            break;
+        }
+        
+        if (!layer(items, elements, "LayerElementNormal", "Normals", "NormalsW", "NormalsIndex", 3, data.normals)) { return false; }
+        if (!layer(items, elements, "LayerElementTangent", "Tangents", "TangentsW", "TangentsIndex", 3, data.tangents)) { return false; }
+        if (!layer(items, elements, "LayerElementColor", "Colors", nullptr, "ColorIndex", 4, data.colors)) { return false; }
+        if (!layer(items, elements, "LayerElementUV", "UV", nullptr, "UVIndex", 2, data.uvs)) { return false; }
+        
+        std::vector<char> results(__arrays.size(), 0);
+        auto inflate = [&](size_t i)
+        {
+            auto &item = __arrays[i];
+            results[i] = item.reals != nullptr ? item.property.values(*item.reals) : item.property.values(*item.integers);
+        };
+        
+        auto compressed = 0;
+        for (auto iter = __arrays.begin(); iter != __arrays.end(); iter++) { compressed += iter->property.encoding != 0; }
+        if (__threads > 1 && compressed > 1)
+        {
+            WorkerPool<void> pool(std::min(__threads, compressed));
+            for (size_t i = 0; i < __arrays.size(); i++) { pool.submit([&, i](void *){ inflate(i); }); }
+            pool.join();
+        }
+        else
+        {
+            for (size_t i = 0; i < __arrays.size(); i++) { inflate(i); }
+        }
+        
+        for (auto iter = results.begin(); iter != results.end(); iter++)
+        {
+            if (!*iter) { return false; }
+        }
+        
+        // polygon ends are stored as bitwise negated indices
+        data.polygons.clear();
+        data.vertices.resize(__indices.size());
+        auto size = 0;
+        for (size_t i = 0; i < __indices.size(); i++)
+        {
+            auto index = __indices[i];
+            ++size;
+            if (index < 0)
+            {
+                index = ~index;
+                data.polygons.push_back(size);
+                size = 0;
+            }
+            data.vertices[i] = index;
+        }
+        std::vector<int>().swap(__indices);
+        return true;
+    }
+    
+    // every mesh geometry that is the node attribute of some model, in file order
+    bool read(BinaryScene &scene, std::function<bool(const BinaryObject &, BinaryGeometry &)> callback)
+    {
+        auto &objects = scene.objects();
+        std::map<int64_t, bool> used;
+        for (auto iter = objects.begin(); iter != objects.end(); iter++)
+        {
+            if (iter->second.model && iter->second.content >= 0) { used[iter->second.content] = true; }
+        }
+        
+        auto &order = scene.order();
+        for (auto iter = order.begin(); iter != order.end(); iter++)
+        {
+            auto &object = objects[*iter];
+            if (!object.mesh || used.find(*iter) == used.end()) { continue; }
+            
+            BinaryGeometry data;
+            data.id = *iter;
+            if (!decode(object.record, data) || !callback(object, data)) { return false; }
+        }
+        return true;
+    }
+};
+
+// sequential writer of rebuilt FBX files, record end offsets are patched once their children are written
+class BinaryWriter
+{
+    int __fd = -1;
+    std::vector<char> __buffer;
+    size_t __used = 0;
+    uint64_t __offset = 0; // file position of buffer start
+    bool __failed = false;
+    
+    bool put(const char *data, size_t size, uint64_t offset)
+    {
+        size_t done = 0;
+        while (done < size)
+        {
+            auto count = pwrite(__fd, data + done, size - done, offset + done);
+            if (count < 0 && errno == EINTR) { continue; }
+            if (count <= 0)
+            {
+                __failed = true;
+                return false;
+            }
+            done += count;
+        }
+        return true;
+    }
+    
+    bool flush()
+    {
+        if (!put(__buffer.data(), __used, __offset)) { return false; }
+        __offset += __used;
+        __used = 0;
+        return true;
+    }
+
+public:
+    BinaryWriter(size_t capacity = 8 << 20): __buffer(capacity) {}
+    BinaryWriter(const BinaryWriter &) = delete;
+    ~BinaryWriter() { close(); }
+    
+    bool open(const std::string &filename)
+    {
+        close();
+        __fd = ::open(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        __offset = 0;
+        __used = 0;
+        __failed = __fd < 0;
+        return __fd >= 0;
+    }
+    
+    uint64_t tell() const { return __offset + __used; }
+    
+    void write(const void *data, size_t size)
+    {
+        if (__fd < 0 || size == 0) { return; }
+        if (__used + size > __buffer.size() && !flush()) { return; }
+        if (size >= __buffer.size())
+        { // large arrays go straight to the file
+            if (put(static_cast<const char *>(data), size, __offset)) { __offset += size; }
+            return;
+        }
+        
+        memcpy(__buffer.data() + __used, data, size);
+        __used += size;
+    }
+    
+    template<typename T>
+    void write(T v) { write(&v, sizeof(T)); }
+    
+    void fill(size_t size)
+    {
+        static const char zeros[128] = {0};
+        for (; size > sizeof(zeros); size -= sizeof(zeros)) { write(zeros, sizeof(zeros)); }
+        write(zeros, size);
+    }
+    
+    // overwrites bytes already written, the part flushed to the file goes there and the rest into the buffer
+    void patch(uint64_t position, const void *data, size_t size)
+    {
+        if (__fd < 0) { return; }
+        auto bytes = static_cast<const char *>(data);
+        if (position < __offset)
+        {
+            auto head = static_cast<size_t>(std::min<uint64_t>(size, __offset - position));
+            put(bytes, head, position);
+            position += head;
+            bytes += head;
+            size -= head;
+        }
+        if (size > 0) { memcpy(__buffer.data() + (position - __offset), bytes, size); }
+    }
+    
+    bool close()
+    {
+        if (__fd < 0) { return !__failed; }
+        flush();
+        ::close(__fd);
+        __fd = -1;
+        return !__failed;
+    }
+};
+
+namespace fbxbinary
+{
+    const unsigned char footerMagic[16] = {0xf8, 0x5a, 0x8c, 0x6a, 0xde, 0xf5, 0xd9, 0x7e, 0xec, 0xe9, 0x0c, 0xe3, 0x75, 0x8f, 0x29, 0x0b};
+    
+    // record header with a zero end offset, returns where to patch it
+    uint64_t begin(BinaryWriter &writer, uint32_t version, uint64_t count, uint64_t bytes, const char *name, uint8_t nameLength)
+    {
+        auto position = writer.tell();
+        if (version >= 7500)
+        {
+            writer.write<uint64_t>(0);
+            writer.write<uint64_t>(count);
+            writer.write<uint64_t>(bytes);
+        }
+        else
+        {
+            writer.write<uint32_t>(0);
+            writer.write<uint32_t>((uint32_t)count);
+            writer.write<uint32_t>((uint32_t)bytes);
+        }
+        writer.write<uint8_t>(nameLength);
+        writer.write(name, nameLength);
+        return position;
+    }
+    
+    void end(BinaryWriter &writer, uint32_t version, uint64_t position)
+    {
+        auto offset = writer.tell();
+        if (version >= 7500)
+        {
+            writer.patch(position, &offset, 8);
+            return;
+        }
+        auto value = (uint32_t)offset;
+        writer.patch(position, &value, 4);
+    }
+    
+    // id, 4 zero bytes, zero padding to 16 byte alignment (never empty), version, 120 zero bytes, magic
+    void footer(BinaryWriter &writer, const char *id, uint32_t version)
+    {
+        writer.write(id, 16);
+        writer.fill(4);
+        auto padding = 16 - writer.tell() % 16;
+        writer.fill(padding);
+        writer.write<uint32_t>(version);
+        writer.fill(120);
+        writer.write(footerMagic, sizeof(footerMagic));
+    }
+}
+
+// builds binary FBX documents record by record: begin(), properties, nested records, end()
+// property counts, sizes and end offsets are patched in, so arrays stream straight into the file
+namespace fbxbinary
+{
+    // zlib stream of array data, false if zlib fails
+    bool deflate(const void *data, size_t size, int level, std::vector<char> &output)
+    {
+        uLongf bound = compressBound(size);
+        output.resize(bound);
+        if (compress2((Bytef *)output.data(), &bound, (const Bytef *)data, size, level) != Z_OK) { return false; }
+        output.resize(bound);
+        return true;
+    }
+}
+
+class BinaryRecordWriter
+{
+    struct Record
+    {
+        uint64_t position;
+        uint64_t count = 0;
+        uint64_t bytes = 0;
+        bool nested = false;
+    };
+    
+    BinaryWriter &__writer;
+    uint32_t __version;
+    int __level;         // zlib level of arrays, 0 for none
+    size_t __threshold;  // smaller arrays are stored as they are
+    std::vector<Record> __records;
+    std::vector<char> __compressed;
+    
+    size_t fields() const { return __version >= 7500 ? 25 : 13; }
+    
+    // properties of a record are done once a nested record starts
+    void close(Record &record)
+    {
+        if (record.nested) { return; }
+        record.nested = true;
+        
+        auto offset = record.position + (__version >= 7500 ? 8 : 4);
+        if (__version >= 7500)
+        {
+            __writer.patch(offset, &record.count, 8);
+            __writer.patch(offset + 8, &record.bytes, 8);
+            return;
+        }
+        uint32_t values[2] = {(uint32_t)record.count, (uint32_t)record.bytes};
+        __writer.patch(offset, values, 8);
+    }
+    
+    void property(char type, const void *data, size_t size)
+    {
+        auto &record = __records.back();
+        __writer.write<char>(type);
+        __writer.write(data, size);
+        record.count += 1;
+        record.bytes += 1 + size;
+    }
+    
+    template<typename T>
+    void array(char type, const T *data, size_t count)
+    {
+        auto size = count * sizeof(T);
+        if (__level > 0 && size >= __threshold && fbxbinary::deflate(data, size, __level, __compressed))
+        {
+            array(type, (uint32_t)count, 1, __compressed.data(), __compressed.size());
+            return;
+        }
+        array(type, (uint32_t)count, 0, data, size);
+    }
+
+public:
+    BinaryRecordWriter(BinaryWriter &writer, uint32_t version = 7400, int level = 0, size_t threshold = 128):
+        __writer(writer), __version(version), __level(level), __threshold(threshold) {}
+    
+    uint32_t version() const { return __version; }
+    
+    void header()
+    {
+        __writer.write(fbxbinary::magic, 23);
+        __writer.write<uint32_t>(__version);
+    }
+    
+    void begin(const std::string &name)
+    {
+        if (!__records.empty()) { close(__records.back()); }
+        
+        Record record;
+        record.position = fbxbinary::begin(__writer, __version, 0, 0, name.data(), (uint8_t)name.size());
+        __records.push_back(record);
+    }
+    
+    void add(bool v) { char c = v ? 1 : 0; property('C', &c, 1); }
+    void add(int32_t v) { property('I', &v, 4); }
+    void add(int64_t v) { property('L', &v, 8); }
+    void add(double v) { property('D', &v, 8); }
+    void add(const char *v) { add(std::string(v)); }
+    
+    void add(const std::string &v)
+    {
+        auto &record = __records.back();
+        __writer.write<char>('S');
+        __writer.write<uint32_t>((uint32_t)v.size());
+        __writer.write(v.data(), v.size());
+        record.count += 1;
+        record.bytes += 5 + v.size();
+    }
+    
+    void raw(const void *data, size_t size)
+    {
+        auto &record = __records.back();
+        __writer.write<char>('R');
+        __writer.write<uint32_t>((uint32_t)size);
+        __writer.write(data, size);
+        record.count += 1;
+        record.bytes += 5 + size;
+    }
+    
+    // array in its stored form, eg. compressed ahead on other threads
+    void array(char type, uint32_t count, uint32_t encoding, const void *data, size_t length)
+    {
+        auto &record = __records.back();
+        __writer.write<char>(type);
+        __writer.write<uint32_t>(count);
+        __writer.write<uint32_t>(encoding);
+        __writer.write<uint32_t>((uint32_t)length);
+        __writer.write(data, length);
+        record.count += 1;
+        record.bytes += 13 + length;
+    }
+    
+    void add(const double *data, size_t count) { array('d', data, count); }
+    void add(const int32_t *data, size_t count) { array('i', data, count); }
+    void add(const std::vector<double> &v) { add(v.data(), v.size()); }
+    void add(const std::vector<int32_t> &v) { add(v.data(), v.size()); }
+    
+    // records with nested records or without properties are closed by a null record
+    void end()
+    {
+        auto record = __records.back();
+        auto terminated = record.nested || record.count == 0;
+        close(record);
+        if (terminated) { __writer.fill(fields()); }
+        fbxbinary::end(__writer, __version, record.position);
+        __records.pop_back();
+    }
+    
+    // single property record, eg. Version: 100
+    template<typename T>
+    void record(const std::string &name, const T &value)
+    {
+        begin(name);
+        add(value);
+        end();
+    }
+    
+    void footer(const char *id)
+    {
+        while (!__records.empty()) { end(); }
+        __writer.fill(fields());
+        fbxbinary::footer(__writer, id, __version);
+    }
+};
+
+#endif /* fbxbinary_h */
@@ -0,0 +1,136 @@
+//
+//  filestream.h
+//  fbxtools
+//
+//  Created by LARRYHOU on 2026/10/19.
+//  Copyright © 2026 LARRYHOU. All rights reserved.
+//
+
+#ifndef filestream_h
+#define filestream_h
+
+#include <fstream>
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+using seek_dir = std::ios_base::seekdir;
+
+class FileStream
+{
+    std::fstream __fs;
+public:
+    FileStream(const char *filename): FileStream(filename, std::fstream::out) {}
+    FileStream(const char *filename, std::ios_base::openmode mode)
+    {
+        __fs.open(filename, mode);
+    }
+    
+    bool good() const { return __fs.good(); }
+    
+    std::fstream::pos_type tellg() { return __fs.tellg(); }
+    void seek(std::fstream::pos_type pos, seek_dir whence)
+    {
+        __fs.seekg(pos, whence);
+    }
+    
+    void alginp(int size = 8)
+    {
+        auto mode = __fs.tellg() % size;
+        if (mode != 0)
+        {
+            for (auto i = 0; i < size - mode; i++){__fs.put(0);}
+        }
+    }
+    
+    template<typename T> T read() { T v; read(v); return v; }
+    template<typename T> void read(T &v);
+    template<typename T> void write(const T &v);
+    
+    template<typename T> void write(const T *v, size_t count);
+    template<typename T> void read(T *v, size_t count);
+    
+    template<typename T>
+    std::vector<T> read_vector()
+    {
+        auto count = read<uint32_t>();
+        std::vector<T> data;
+        data.reserve(count);
+        for (auto i = 0; i < count; i++) { data.push_back(read<T>()); }
+        return data;
+    }
+    
+    template<typename T>
+    void read_vector(std::vector<T> &v)
+    {
+        auto count = read<uint32_t>();
+        
+        v.resize(count);
+        for (auto i = 0; i < count; i++) { v[i] = read<T>(); }
+    }
+    
+    template<typename T>
+    void write_vector(const std::vector<T> &v)
+    {
+        write(static_cast<uint32_t>(v.size()));
+        for (auto iter = v.begin(); iter != v.end(); iter++)
+        {
+            write(*iter);
+        }
+    }
+    
+    ~FileStream() { __fs.close();  }
+};
+
+template<typename T>
+void FileStream::write(const T &v)
+{
+    __fs.write((const char *)&v, sizeof(T));
+}
+
+template<typename T>
+void FileStream::read(T &v)
+{
+    __fs.read((char *)&v, sizeof(T));
+}
+
+template<typename T>
+void FileStream::write(const T *v, size_t count)
+{
+    __fs.write((const char *)v, sizeof(T) * count);
+}
+
+template<typename T>
+void FileStream::read(T *v, size_t count)
+{
+    __fs.read((char *)v, sizeof(T) * count);
+}
+
+template<>
+void FileStream::write(const char *v, size_t count)
+{
+    __fs.write(v, count);
+}
+
+template<>
+void FileStream::read(char *v, size_t count)
+{
+    __fs.read(v, count);
+}
+
+template<>
+void FileStream::write(const std::string &v)
+{
+    write(static_cast<uint32_t>(v.size()));
+    __fs.write(v.c_str(), v.size());
+}
+
+template<>
+void FileStream::read(std::string &s)
+{
+    auto size = read<uint32_t>();
+    s.resize(size);
+    __fs.read(const_cast<char*>(s.data()), size);
+}
+
+#endif /* filestream_h */
@@ -0,0 +1,283 @@
+//
+//  json.h
+//  fbxtools
+//
+//  Created by LARRYHOU on 2026/10/19.
+//  Copyright © 2026 LARRYHOU. All rights reserved.
+//
+
+#ifndef json_h
+#define json_h
+
+#include <string>
+#include <vector>
+#include <utility>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+struct Json
+{
+    enum EType
+    {
+        eNull, eBool, eNumber, eString, eArray, eObject
+    };
+    
+    EType type = eNull;
+    bool boolean = false;
+    double number = 0;
+    std::string text;
+    std::vector<Json> items;
+    std::vector<std::pair<std::string, Json>> members;
+    
+    Json() {}
+    Json(bool v): type(eBool), boolean(v) {}
+    Json(int v): type(eNumber), number(v) {}
+    Json(long long v): type(eNumber), number((double)v) {}
+    Json(double v): type(eNumber), number(v) {}
+    Json(const char *v): type(eString), text(v) {}
+    Json(const std::string &v): type(eString), text(v) {}
+    
+    static Json array() { Json v; v.type = eArray; return v; }
+    static Json object() { Json v; v.type = eObject; return v; }
+    
+    Json &push(const Json &v) { items.push_back(v); return *this; }
+    Json &set(const std::string &key, const Json &v) { members.push_back(std::make_pair(key, v)); return *this; }
+    
+    const Json *find(const std::string &key) const
+    {
+        for (auto iter = members.begin(); iter != members.end(); iter++)
+        {
+            if (iter->first == key) { return &iter->second; }
+        }
+        return nullptr;
+    }
+    
+    // scalar rendered the way ArgumentOptions stores option values
+    std::string str() const
+    {
+        switch (type)
+        {
+            case eBool: return boolean ? "1" : "0";
+            case eString: return text;
+            case eNumber:
+            {
+                char buffer[32];
+                if (number == (long long)number) { snprintf(buffer, sizeof(buffer), "%lld", (long long)number); }
+                else { snprintf(buffer, sizeof(buffer), "%.15g", number); }
+                return buffer;
+            }
+            default: return "";
+        }
+    }
+    
+    std::string dump() const
+    {
+        std::string out;
+        dump(out);
+        return out;
+    }
+    
+    void dump(std::string &out) const
+    {
+        switch (type)
+        {
+            case eNull: out += "null"; break;
+            case eBool: out += boolean ? "true" : "false"; break;
+            case eNumber: out += str(); break;
+            case eString: quote(text, out); break;
+            case eArray:
+            {
+                out += '[';
+                for (auto i = 0; i < items.size(); i++)
+                {
+                    if (i > 0) { out += ','; }
+                    items[i].dump(out);
+                }
+                out += ']';
+                break;
+            }
+            case eObject:
+            {
+                out += '{';
+                for (auto i = 0; i < members.size(); i++)
+                {
+                    if (i > 0) { out += ','; }
+                    quote(members[i].first, out);
+                    out += ':';
+                    members[i].second.dump(out);
+                }
+                out += '}';
+                break;
+            }
+        }
+    }
+    
+    static void quote(const std::string &s, std::string &out)
+    {
+        out += '"';
+        for (auto iter = s.begin(); iter != s.end(); iter++)
+        {
+            auto c = static_cast<unsigned char>(*iter);
+            switch (c)
+            {
+                case '"': out += "\\\""; break;
+                case '\\': out += "\\\\"; break;
+                case '\n': out += "\\n"; break;
+                case '\r': out += "\\r"; break;
+                case '\t': out += "\\t"; break;
+                default:
+                    if (c < 0x20)
+                    {
+                        char buffer[8];
+                        snprintf(buffer, sizeof(buffer), "\\u%04x", c);
+                        out += buffer;
+                    }
+                    else { out += *iter; }
+                    break;
+            }
+        }
+        out += '"';
+    }
+    
+    static bool parse(const std::string &s, Json &v)
+    {
+        size_t pos = 0;
+        if (!parse(s, pos, v)) { return false; }
+        skip(s, pos);
+        return pos == s.size();
+    }
+
+private:
+    static void skip(const std::string &s, size_t &pos)
+    {
+        while (pos < s.size() && (s[pos] == ' ' || s[pos] == '\t' || s[pos] == '\n' || s[pos] == '\r')) { ++pos; }
+    }
+    
+    static bool literal(const std::string &s, size_t &pos, const char *word)
+    {
+        auto size = strlen(word);
+        if (s.compare(pos, size, word) != 0) { return false; }
+        pos += size;
+        return true;
+    }
+    
+    static void utf8(unsigned code, std::string &out)
+    {
+        if (code < 0x80) { out += (char)code; }
+        else if (code < 0x800)
+        {
+            out += (char)(0xC0 | (code >> 6));
+            out += (char)(0x80 | (code & 0x3F));
+        }
+        else
+        {
+            out += (char)(0xE0 | (code >> 12));
+            out += (char)(0x80 | ((code >> 6) & 0x3F));
+            out += (char)(0x80 | (code & 0x3F));
+        }
+    }
+    
+    static bool string(const std::string &s, size_t &pos, std::string &out)
+    {
+        if (s[pos] != '"') { return false; }
+        ++pos;
+        while (pos < s.size())
+        {
+            auto c = s[pos++];
+            if (c == '"') { return true; }
+            if (c != '\\') { out += c; continue; }
+            if (pos >= s.size()) { return false; }
+            c = s[pos++];
+            switch (c)
+            {
+                case 'n': out += '\n'; break;
+                case 'r': out += '\r'; break;
+                case 't': out += '\t'; break;
+                case 'b': out += '\b'; break;
+                case 'f': out += '\f'; break;
+                case 'u':
+                {
+                    if (pos + 4 > s.size()) { return false; }
+                    utf8((unsigned)strtoul(s.substr(pos, 4).c_str(), nullptr, 16), out);
+                    pos += 4;
+                    break;
+                }
+                default: out += c; break;
+            }
+        }
+        return false;
+    }
+    
+    static bool parse(const std::string &s, size_t &pos, Json &v)
+    {
+        skip(s, pos);
+        if (pos >= s.size()) { return false; }
+        
+        auto c = s[pos];
+        if (c == '{')
+        {
+            v = object();
+            ++pos;
+            skip(s, pos);
+            if (pos < s.size() && s[pos] == '}') { ++pos; return true; }
+            while (pos < s.size())
+            {
+                skip(s, pos);
+                std::string key;
+                if (pos >= s.size() || !string(s, pos, key)) { return false; }
+                skip(s, pos);
+                if (pos >= s.size() || s[pos++] != ':') { return false; }
+                Json item;
+                if (!parse(s, pos, item)) { return false; }
+                v.set(key, item);
+                skip(s, pos);
+                if (pos >= s.size()) { return false; }
+                if (s[pos] == ',') { ++pos; continue; }
+                if (s[pos] == '}') { ++pos; return true; }
+                return false;
+            }
+            return false;
+        }
+        
+        if (c == '[')
+        {
+            v = array();
+            ++pos;
+            skip(s, pos);
+            if (pos < s.size() && s[pos] == ']') { ++pos; return true; }
+            while (pos < s.size())
+            {
+                Json item;
+                if (!parse(s, pos, item)) { return false; }
+                v.push(item);
+                skip(s, pos);
+                if (pos >= s.size()) { return false; }
+                if (s[pos] == ',') { ++pos; continue; }
+                if (s[pos] == ']') { ++pos; return true; }
+                return false;
+            }
+            return false;
+        }
+        
+        if (c == '"')
+        {
+            v = Json("");
+            return string(s, pos, v.text);
+        }
+        
+        if (literal(s, pos, "true")) { v = Json(true); return true; }
+        if (literal(s, pos, "false")) { v = Json(false); return true; }
+        if (literal(s, pos, "null")) { v = Json(); return true; }
+        
+        auto begin = s.c_str() + pos;
+        char *end = nullptr;
+        auto number = strtod(begin, &end);
+        if (end == begin) { return false; }
+        pos += end - begin;
+        v = Json(number);
+        return true;
+    }
+};
+
+#endif /* json_h */
@@ -0,0 +1,43 @@
+//
+//  profile.h
+//  fbxtools
+//
+//  Created by LARRYHOU on 2026/10/19.
+//  Copyright © 2026 LARRYHOU. All rights reserved.
+//
+
+#ifndef profile_h
+#define profile_h
+
+#include <chrono>
+#include <sys/resource.h>
+
+class Stopwatch
+{
+    std::chrono::steady_clock::time_point __start;
+
+public:
+    Stopwatch(): __start(std::chrono::steady_clock::now()) {}
+    
+    void reset() { __start = std::chrono::steady_clock::now(); }
+    
+    double elapsed() const
+    {
+        std::chrono::duration<double> duration = std::chrono::steady_clock::now() - __start;
+        return duration.count();
+    }
+};
+
+// high water mark of resident memory of the whole process in MB, shared by all jobs running in parallel
+double peakMemory()
+{
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) { return 0; }
+#ifdef __APPLE__
+    return usage.ru_maxrss / 1048576.0; // bytes
+#else
+    return usage.ru_maxrss / 1024.0; // kilobytes
+#endif
+}
+
+#endif /* profile_h */
@@ -0,0 +1,393 @@
+//
+//  streams.h
+//  fbxtools
+//
+//  Created by LARRYHOU on 2026/10/19.
+//  Copyright © 2026 LARRYHOU. All rights reserved.
+//
+
+#ifndef streams_h
+#define streams_h
+
+#include <fbxsdk.h>
+#include <arguments.h>
+#include <archive.h>
+#include <allocation.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// read only stream over bytes in memory, Open() rewinds
+class MemoryStream: public FbxStream
+{
+protected:
+    const char *__data = nullptr;
+    size_t __size = 0;
+    mutable size_t __position = 0;
+    mutable int __error = 0;
+    EState __state = eClosed;
+
+public:
+    int format = -1;
+    
+    MemoryStream() {}
+    MemoryStream(const void *data, size_t size, int format = -1): __data(static_cast<const char *>(data)), __size(size), format(format) {}
+    MemoryStream(const MemoryStream &) = delete;
+    
+    const char *data() const { return __data; }
+    size_t size() const { return __size; }
+    
+    EState GetState() override { return __state; }
+    
+    bool Open(void *) override
+    {
+        __position = 0;
+        __state = __data == nullptr ? eEmpty : eOpen;
+        return true;
+    }
+    
+    bool Close() override
+    {
+        __position = 0;
+        __state = eClosed;
+        return true;
+    }
+    
+    bool Flush() override { return true; }
+    
+    int Write(const void *, int) override
+    {
+        __error = 1;
+        return 0;
+    }
+    
+    int Read(void *data, int size) const override
+    {
+        if (__data == nullptr || size <= 0 || __position >= __size) { return 0; }
+        auto count = std::min(static_cast<size_t>(size), __size - __position);
+        memcpy(data, __data + __position, count);
+        __position += count;
+        return static_cast<int>(count);
+    }
+    
+    // same contract as fgets(), the default implementation reads one byte at a time
+    char *ReadString(char *buffer, int maxSize, bool stopAtFirstWhiteSpace = false) override
+    {
+        if (stopAtFirstWhiteSpace) { return FbxStream::ReadString(buffer, maxSize, stopAtFirstWhiteSpace); }
+        if (__data == nullptr || maxSize <= 0 || __position >= __size) { return nullptr; }
+        
+        auto limit = std::min(static_cast<size_t>(maxSize - 1), __size - __position);
+        auto start = __data + __position;
+        auto end = static_cast<const char *>(memchr(start, '\n', limit));
+        auto count = end == nullptr ? limit : end - start + 1;
+        memcpy(buffer, start, count);
+        buffer[count] = 0;
+        __position += count;
+        return buffer;
+    }
+    
+    int GetReaderID() const override { return format; }
+    int GetWriterID() const override { return -1; }
+    
+    void Seek(const FbxInt64 &offset, const FbxFile::ESeekPos &seekPos) override
+    {
+        long long base = 0;
+        switch (seekPos)
+        {
+            case FbxFile::eBegin: base = 0; break;
+            case FbxFile::eCurrent: base = __position; break;
+            case FbxFile::eEnd: base = __size; break;
+        }
+        
+        auto position = base + offset;
+        if (position < 0 || position > (long long)__size)
+        {
+            __error = 1;
+            position = std::max(0LL, std::min(position, (long long)__size));
+        }
+        __position = static_cast<size_t>(position);
+    }
+    
+    long GetPosition() const override { return static_cast<long>(__position); }
+    void SetPosition(long position) override { Seek(position, FbxFile::eBegin); }
+    
+    int GetError() const override { return __error; }
+    void ClearError() override { __error = 0; }
+};
+
+// memory stream over a mapped file or archive entry, Open() takes the file name or archive.zip#entry as stream data
+class MappedFileStream: public MemoryStream
+{
+    MappedSource __source;
+
+public:
+    ~MappedFileStream() { Close(); }
+    
+    bool Open(void *streamData) override
+    {
+        Close();
+        if (!__source.open(static_cast<const char *>(streamData)))
+        {
+            __error = 1;
+            return false;
+        }
+        
+        __data = __source.data();
+        __size = __source.size();
+        __position = 0;
+        __state = eOpen;
+        return true;
+    }
+    
+    bool Close() override
+    {
+        __source.close();
+        __data = nullptr;
+        __size = 0;
+        return MemoryStream::Close();
+    }
+};
+
+// write only stream that turns the many small writes of FBX writers into few large ones
+class BufferedFileStream: public FbxStream
+{
+    int __fd = -1;
+    std::vector<char> __buffer;
+    size_t __used = 0;
+    long long __offset = 0; // file position of buffer start
+    int __error = 0;
+    
+    bool put(const char *data, size_t size, long long offset)
+    {
+        size_t done = 0;
+        while (done < size)
+        {
+            auto count = pwrite(__fd, data + done, size - done, offset + done);
+            if (count < 0 && errno == EINTR) { continue; }
+            if (count <= 0)
+            {
+                __error = 1;
+                return false;
+            }
+            done += count;
+        }
+        return true;
+    }
+    
+    bool flush()
+    {
+        if (!put(__buffer.data(), __used, __offset)) { return false; }
+        __offset += __used;
+        __used = 0;
+        return true;
+    }
+
+public:
+    int format = -1;
+    
+    BufferedFileStream(size_t capacity = 8 << 20): __buffer(capacity) {}
+    BufferedFileStream(const BufferedFileStream &) = delete;
+    ~BufferedFileStream() { Close(); }
+    
+    EState GetState() override { return __fd < 0 ? eClosed : eOpen; }
+    
+    bool Open(void *streamData) override
+    {
+        Close();
+        __fd = ::open(static_cast<const char *>(streamData), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        __offset = 0;
+        __used = 0;
+        if (__fd < 0) { __error = 1; }
+        return __fd >= 0;
+    }
+    
+    bool Close() override
+    {
+        if (__fd < 0) { return true; }
+        flush();
+        ::close(__fd);
+        __fd = -1;
+        return __error == 0;
+    }
+    
+    bool Flush() override { return __fd >= 0 && flush(); }
+    
+    int Write(const void *data, int size) override
+    {
+        if (__fd < 0 || size <= 0) { return 0; }
+        
+        auto capacity = __buffer.size();
+        if (__used + size > capacity && !flush()) { return 0; }
+        if (static_cast<size_t>(size) >= capacity)
+        { // large blocks go straight to the file
+            if (!put(static_cast<const char *>(data), size, __offset)) { return 0; }
+            __offset += size;
+            return size;
+        }
+        
+        memcpy(__buffer.data() + __used, data, size);
+        __used += size;
+        return size;
+    }
+    
+    int Read(void *, int) const override { return 0; }
+    
+    int GetReaderID() const override { return -1; }
+    int GetWriterID() const override { return format; }
+    
+    void Seek(const FbxInt64 &offset, const FbxFile::ESeekPos &seekPos) override
+    {
+        if (__fd < 0 || !flush()) { return; }
+        
+        long long base = 0;
+        switch (seekPos)
+        {
+            case FbxFile::eBegin: base = 0; break;
+            case FbxFile::eCurrent: base = __offset; break;
+            case FbxFile::eEnd:
+            {
+                struct stat st;
+                base = fstat(__fd, &st) == 0 ? st.st_size : __offset;
+                break;
+            }
+        }
+        
+        if (base + offset < 0) { __error = 1; return; }
+        __offset = base + offset;
+    }
+    
+    long GetPosition() const override { return static_cast<long>(__offset + __used); }
+    void SetPosition(long position) override { Seek(position, FbxFile::eBegin); }
+    
+    int GetError() const override { return __error; }
+    void ClearError() override { __error = 0; }
+};
+
+namespace streams
+{
+    // FBXTOOLS_IO=file sends every import and export through the SDK's own file access
+    bool enabled()
+    {
+        auto mode = getenv("FBXTOOLS_IO");
+        return mode == nullptr || strcmp(mode, "file") != 0;
+    }
+    
+    // only the FBX plugins take streams, other formats keep using file names
+    bool native(const std::string &filename)
+    {
+        auto pos = filename.rfind('.');
+        if (pos == std::string::npos) { return false; }
+        auto extension = filename.substr(pos + 1);
+        std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+        return extension == "fbx";
+    }
+}
+
+// the stream is read during Import() and must outlive it, archive entries can only be read through streams
+bool initialize(FbxImporter *importer, MappedFileStream &stream, const std::string &filename, FbxIOSettings *settings, bool mapped = streams::enabled())
+{
+    std::string file, entry;
+    if (archive::split(filename, file, entry)) { mapped = true; }
+    
+    if (mapped && streams::native(filename))
+    {
+        stream.format = importer->GetFbxManager()->GetIOPluginRegistry()->FindReaderIDByExtension("fbx");
+        if (importer->Initialize(&stream, (void *)filename.c_str(), stream.format, settings)) { return true; }
+    }
+    
+    // also where a failed stream open picks up the SDK's error status
+    return importer->Initialize(filename.c_str(), -1, settings);
+}
+
+// the stream is written during Export() and must outlive it
+bool initialize(FbxExporter *exporter, BufferedFileStream &stream, const std::string &filename, FbxIOSettings *settings, int format = -1)
+{
+    if (streams::enabled() && streams::native(filename))
+    {
+        auto registry = exporter->GetFbxManager()->GetIOPluginRegistry();
+        stream.format = format >= 0 ? format : registry->FindWriterIDByExtension("fbx");
+        if (exporter->Initialize(&stream, (void *)filename.c_str(), stream.format, settings)) { return true; }
+    }
+    
+    return exporter->Initialize(filename.c_str(), format, settings);
+}
+
+// ?format=binary|ascii, ?fbxversion=7400, ?compresslevel=0-9 with 0 for uncompressed arrays and ?compressmin=bytes
+// of arrays left uncompressed, shared by every tool writing FBX, unset ones keep what the SDK writes by default
+struct ExportOptions
+{
+    std::string format;
+    int version = 0;
+    int level = -1;
+    int minsize = -1;
+    
+    ExportOptions() {}
+    
+    ExportOptions(ArgumentOptions &args)
+    {
+        std::string value;
+        args.get("format", format);
+        if (args.get("fbxversion", value)) { version = atoi(value.c_str()); }
+        if (args.get("compresslevel", value)) { level = std::min(9, std::max(0, atoi(value.c_str()))); }
+        if (args.get("compressmin", value)) { minsize = std::max(0, atoi(value.c_str())); }
+    }
+    
+    bool ascii() const { return format == "ascii"; }
+    
+    // SetFileExportVersion() names of FBX file versions
+    const char *compatibility() const
+    {
+        switch (version)
+        {
+            case 0: return FBX_DEFAULT_FILE_COMPATIBILITY;
+            case 7100: return FBX_2011_00_COMPATIBLE;
+            case 7200: return FBX_2012_00_COMPATIBLE;
+            case 7300: return FBX_2013_00_COMPATIBLE;
+            case 7400: return FBX_2014_00_COMPATIBLE;
+            case 7500: return FBX_2016_00_COMPATIBLE;
+            case 7700: return FBX_2019_00_COMPATIBLE;
+            default: return nullptr;
+        }
+    }
+    
+    // settings of a manager outlive the job, so every export sets all of them
+    void apply(FbxIOSettings *settings) const
+    {
+        auto level = this->level < 0 ? 1 : this->level;
+        settings->SetBoolProp(EXP_FBX_COMPRESS_ARRAYS, level > 0);
+        settings->SetIntProp(EXP_FBX_COMPRESS_LEVEL, std::max(1, level));
+        settings->SetIntProp(EXP_FBX_COMPRESS_MINSIZE, minsize < 0 ? 1024 : minsize);
+    }
+    
+    // writer of the format, -1 for the SDK's choice by extension
+    int writer(FbxExporter *exporter, const std::string &filename) const
+    {
+        if (format.empty() || !streams::native(filename)) { return -1; }
+        auto registry = exporter->GetFbxManager()->GetIOPluginRegistry();
+        return registry->FindWriterIDByDescription(ascii() ? "FBX ascii (*.fbx)" : "FBX binary (*.fbx)");
+    }
+};
+
+bool initialize(FbxExporter *exporter, BufferedFileStream &stream, const std::string &filename, FbxIOSettings *settings, const ExportOptions &options)
+{
+    if (!streams::native(filename)) { return initialize(exporter, stream, filename, settings); }
+    
+    auto compatibility = options.compatibility();
+    if (compatibility == nullptr)
+    {
+        exporter->GetStatus().SetCode(FbxStatus::eInvalidParameter, "unsupported FBX version %d", options.version);
+        return false;
+    }
+    
+    options.apply(settings);
+    return initialize(exporter, stream, filename, settings, options.writer(exporter, filename)) && exporter->SetFileExportVersion(compatibility);
+}
+
+#endif /* streams_h */
@@ -0,0 +1,335 @@
+//
+//  workers.h
+//  fbxtools
+//
+//  Created by LARRYHOU on 2026/10/19.
+//  Copyright © 2026 LARRYHOU. All rights reserved.
+//
+
+#ifndef workers_h
+#define workers_h
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <deque>
+#include <exception>
+#include <map>
+#include <vector>
+#include <stdarg.h>
+#include <stdio.h>
+
+namespace console
+{
+    thread_local std::string *__buffer = nullptr;
+    std::mutex __mutex;
+}
+
+// printf replacement, collects text into the capture of current job if there is one
+int output(const char *format, ...)
+{
+    va_list args;
+    va_start(args, format);
+    int size;
+    if (console::__buffer == nullptr)
+    {
+        size = vprintf(format, args);
+    }
+    else
+    {
+        char text[1024];
+        va_list copy;
+        va_copy(copy, args);
+        size = vsnprintf(text, sizeof(text), format, copy);
+        va_end(copy);
+        if (size >= 0 && size < (int)sizeof(text)) // negative for encoding errors, nothing is kept then
+        {
+            console::__buffer->append(text, size);
+        }
+        else if (size > 0)
+        {
+            auto offset = console::__buffer->size();
+            console::__buffer->resize(offset + size + 1);
+            vsnprintf(&(*console::__buffer)[offset], size + 1, format, args);
+            console::__buffer->resize(offset + size);
+        }
+    }
+    va_end(args);
+    return size;
+}
+
+int output(const std::string &text)
+{
+    if (console::__buffer == nullptr)
+    {
+        fwrite(text.data(), 1, text.size(), stdout);
+    }
+    else
+    {
+        console::__buffer->append(text);
+    }
+    return (int)text.size();
+}
+
+class ConsoleCapture
+{
+    std::string __text;
+    std::string *__previous;
+    bool __enabled;
+
+public:
+    ConsoleCapture(bool enabled = true): __previous(console::__buffer), __enabled(enabled)
+    {
+        if (__enabled) { console::__buffer = &__text; }
+    }
+    
+    std::string &text() { return __text; }
+    
+    ~ConsoleCapture()
+    {
+        if (__enabled) { console::__buffer = __previous; }
+    }
+};
+
+// files written and numbers reported by a job, kept for caching and result reports
+struct JobRecord
+{
+    std::vector<std::string> outputs;
+    std::map<std::string, long long> counters;
+};
+
+namespace jobs
+{
+    thread_local JobRecord *__record = nullptr;
+}
+
+class JobScope
+{
+    JobRecord *__previous;
+
+public:
+    JobScope(JobRecord &record): __previous(jobs::__record) { jobs::__record = &record; }
+    ~JobScope() { jobs::__record = __previous; }
+};
+
+void produced(const std::string &path)
+{
+    if (jobs::__record != nullptr) { jobs::__record->outputs.push_back(path); }
+}
+
+void tally(const std::string &name, long long value)
+{
+    if (jobs::__record != nullptr) { jobs::__record->counters[name] += value; }
+}
+
+// flushes captured job logs to stdout in submission order, or into the capture of an enclosing job
+class OrderedOutput
+{
+    std::mutex __mutex;
+    std::vector<std::string> __logs;
+    std::vector<bool> __finished;
+    size_t __next = 0;
+    std::string *__target;
+
+public:
+    OrderedOutput(std::string *target = nullptr): __target(target) {}
+    
+    size_t open()
+    {
+        std::lock_guard<std::mutex> lock(__mutex);
+        __logs.emplace_back();
+        __finished.push_back(false);
+        return __logs.size() - 1;
+    }
+    
+    void close(size_t index, const std::string &text)
+    {
+        std::lock_guard<std::mutex> lock(__mutex);
+        __logs[index] = text;
+        __finished[index] = true;
+        
+        if (__target != nullptr)
+        {
+            for (; __next < __finished.size() && __finished[__next]; __next++)
+            {
+                __target->append(__logs[__next]);
+                std::string().swap(__logs[__next]);
+            }
+            return;
+        }
+        
+        std::lock_guard<std::mutex> guard(console::__mutex);
+        while (__next < __finished.size() && __finished[__next])
+        {
+            auto &log = __logs[__next];
+            fwrite(log.data(), 1, log.size(), stdout);
+            std::string().swap(log);
+            ++__next;
+        }
+        fflush(stdout);
+    }
+};
+
+// closes a slot with what the job captured however the job ends, logs after an open slot would wait forever
+class OrderedSlot
+{
+    OrderedOutput &__output;
+    size_t __index;
+    ConsoleCapture &__capture;
+
+public:
+    OrderedSlot(OrderedOutput &output, size_t index, ConsoleCapture &capture): __output(output), __index(index), __capture(capture) {}
+    ~OrderedSlot() { __output.close(__index, __capture.text()); }
+};
+
+// FbxManager creation and teardown touch the global plugin registry, one lock for every pool and tool thread
+std::mutex &sdk()
+{
+    static std::mutex mutex;
+    return mutex;
+}
+
+template<typename Context>
+class WorkerPool
+{
+    std::vector<std::thread> __threads;
+    std::deque<std::function<void(Context *)>> __queue;
+    std::mutex __mutex;
+    std::condition_variable __condition;
+    bool __closed = false;
+    
+    std::function<Context *()> __create;
+    std::function<void(Context *)> __destroy;
+    
+    void loop()
+    {
+        Context *context = nullptr;
+        if (__create)
+        { // FbxManager creation touches global plugin registry
+            std::lock_guard<std::mutex> lock(sdk());
+            context = __create();
+        }
+        
+        while (true)
+        {
+            std::function<void(Context *)> job;
+            {
+                std::unique_lock<std::mutex> lock(__mutex);
+                __condition.wait(lock, [&]{ return __closed || !__queue.empty(); });
+                if (__queue.empty()) { break; }
+                job = std::move(__queue.front());
+                __queue.pop_front();
+            }
+            job(context);
+        }
+        
+        if (__destroy)
+        {
+            std::lock_guard<std::mutex> lock(sdk());
+            __destroy(context);
+        }
+    }
+
+public:
+    WorkerPool(int count, std::function<Context *()> create = nullptr, std::function<void(Context *)> destroy = nullptr):
+        __create(create), __destroy(destroy)
+    {
+        if (count < 1) { count = 1; }
+        for (auto i = 0; i < count; i++)
+        {
+            __threads.emplace_back(&WorkerPool::loop, this);
+        }
+    }
+    
+    void submit(std::function<void(Context *)> job)
+    {
+        {
+            std::lock_guard<std::mutex> lock(__mutex);
+            __queue.push_back(std::move(job));
+        }
+        __condition.notify_one();
+    }
+    
+    void join()
+    {
+        {
+            std::lock_guard<std::mutex> lock(__mutex);
+            __closed = true;
+        }
+        __condition.notify_all();
+        for (auto iter = __threads.begin(); iter != __threads.end(); iter++)
+        {
+            if (iter->joinable()) { iter->join(); }
+        }
+    }
+    
+    ~WorkerPool() { join(); }
+};
+
+// bounds work handed to a pool, acquire() blocks while limit items are in flight
+class Throttle
+{
+    std::mutex __mutex;
+    std::condition_variable __condition;
+    int __limit;
+    int __count = 0;
+
+public:
+    Throttle(int limit): __limit(limit < 1 ? 1 : limit) {}
+    
+    void acquire()
+    {
+        std::unique_lock<std::mutex> lock(__mutex);
+        __condition.wait(lock, [this] { return __count < __limit; });
+        ++__count;
+    }
+    
+    void release()
+    {
+        {
+            std::lock_guard<std::mutex> lock(__mutex);
+            --__count;
+        }
+        __condition.notify_one();
+    }
+};
+
+// runs process(context, index) for every index on a pool of workers, each worker owns its context
+// console output of every job is buffered and printed in index order when running in parallel
+// returns number of failed jobs
+template<typename Context>
+int dispatch(int jobs, int count,
+             std::function<Context *()> create, std::function<void(Context *)> destroy,
+             std::function<bool(Context *, int)> process)
+{
+    if (jobs > count) { jobs = count; }
+    
+    OrderedOutput console;
+    std::vector<char> results(count, 0);
+    {
+        WorkerPool<Context> pool(jobs, create, destroy);
+        for (auto i = 0; i < count; i++)
+        {
+            auto slot = console.open();
+            pool.submit([&, i, slot](Context *context)
+            {
+                ConsoleCapture capture(jobs > 1);
+                OrderedSlot closing(console, slot, capture);
+                try { results[i] = process(context, i); }
+                catch (const std::exception &e) { output("[E] %s\n", e.what()); }
+            });
+        }
+        pool.join();
+    }
+    
+    auto failures = 0;
+    for (auto iter = results.begin(); iter != results.end(); iter++)
+    {
+        if (!*iter) { ++failures; }
+    }
+    return failures;
+}
+
+#endif /* workers_h */
@@ -8,41 +8,677 @@
 
 #include <string>
 #include <iostream>
+#include <vector>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <algorithm>
+#include <unordered_map>
+#include <map>
+#include <math.h>
 
 #include <fbxsdk.h>
 #include <fbxsdk/fileio/fbxiosettings.h>
 #include <fbxsdk/core/fbxdatatypes.h>
+#include <streams.h>
+#include <workers.h>
+#include <cache.h>
 #include "fbxptr.hpp"
 
-void merge(std::string filename, FbxScene *parent)
+// one input parsed on a worker into a manager of its own, merged and released by the main thread in argument order
+struct SourceScene
+{
+    FbxManager *manager = nullptr;
+    FbxScene *scene = nullptr;
+    bool done = false;
+};
+
+void load(std::string filename, SourceScene &source)
 {
-    auto manager = parent->GetFbxManager();
-    FbxPtr<FbxImporter> importer(FbxImporter::Create(manager, ""));
-    if (!importer->Initialize(filename.c_str(), -1, manager->GetIOSettings())) { return; }
-    
-    auto scene = FbxScene::Create(manager, "Scene");
-    if (!importer->Import(scene)) { return; }
-    
-    for (auto i = 0; i < scene->GetRootNode()->GetChildCount(); i++)
     {
-        parent->GetRootNode()->AddChild(scene->GetRootNode()->GetChild(i));
+        std::lock_guard<std::mutex> lock(sdk());
+        source.manager = FbxManager::Create();
+        source.manager->SetIOSettings(FbxIOSettings::Create(source.manager, IOSROOT));
     }
     
-    scene->GetRootNode()->DisconnectAllSrcObject();
+    auto manager = source.manager;
+    MappedFileStream stream;
+    auto importer = FbxImporter::Create(manager, "");
+    if (initialize(importer, stream, filename, manager->GetIOSettings()))
+    {
+        auto scene = FbxScene::Create(manager, "Scene");
+        if (importer->Import(scene)) { source.scene = scene; }
+    }
+    importer->Destroy();
+}
+
+// clones every object of the source scene into the parent with connections between them kept,
+// connections to the source scene and its root node are dropped so nothing points back into the other scene,
+// detached tells whether every clone lives in the parent's manager, otherwise the source manager has to outlive the export
+bool merge(SourceScene &source, FbxScene *parent, bool &detached)
+{
+    auto scene = source.scene;
+    auto root = scene->GetRootNode();
     
+    std::vector<FbxObject *> objects;
+    FbxCloneManager::CloneSet set;
+    FbxCloneManager::CloneSetElement element(FbxCloneManager::sConnectToClone, 0, FbxObject::eDeepClone);
     for (auto i = 0; i < scene->GetSrcObjectCount(); i++)
     {
         auto obj = scene->GetSrcObject(i);
-        if (obj == scene->GetRootNode() || *obj == scene->GetGlobalSettings()) { continue; }
-        obj->ConnectDstObject(parent);
+        if (obj == root || *obj == scene->GetGlobalSettings()) { continue; }
+        objects.push_back(obj);
+        set.Insert(obj, element);
+    }
+    
+    detached = false;
+    FbxCloneManager cloner;
+    if (!cloner.Clone(set, parent)) { return false; }
+    
+    // clones were created in pointer order of the set, reconnect them in source order so the output doesn't vary between runs
+    detached = true;
+    for (auto iter = objects.begin(); iter != objects.end(); iter++)
+    {
+        auto clone = set.Find(*iter)->GetValue().mObjectClone;
+        if (clone == nullptr) { continue; }
+        if (clone->GetFbxManager() != parent->GetFbxManager()) { detached = false; }
+        clone->DisconnectDstObject(parent);
+        clone->ConnectDstObject(parent);
+    }
+    
+    for (auto i = 0; i < root->GetChildCount(); i++)
+    {
+        auto entry = set.Find(root->GetChild(i));
+        if (entry == nullptr) { continue; }
+        auto clone = FbxCast<FbxNode>(entry->GetValue().mObjectClone);
+        if (clone != nullptr) { parent->GetRootNode()->AddChild(clone); }
+    }
+    return true;
+}
+
+// source managers still owning clones merged into the scene, released once the export is done
+class RetainedManagers
+{
+    std::vector<FbxManager *> __managers;
+    
+public:
+    void add(FbxManager *manager) { __managers.push_back(manager); }
+    
+    ~RetainedManagers()
+    {
+        std::lock_guard<std::mutex> lock(sdk());
+        for (auto iter = __managers.begin(); iter != __managers.end(); iter++) { (*iter)->Destroy(); }
+    }
+};
+
+template<typename T>
+void hash_value(ContentHash &hash, const FbxProperty &property)
+{
+    auto value = property.Get<T>();
+    hash.update(&value, sizeof(value));
+}
+
+// values and sources of every property, false for property types that can't be compared by value
+bool hash_properties(ContentHash &hash, FbxObject *obj)
+{
+    for (auto p = obj->GetFirstProperty(); p.IsValid(); p = obj->GetNextProperty(p))
+    {
+        hash.update(std::string(p.GetName().Buffer()));
+        auto type = p.GetPropertyDataType().GetType();
+        hash.update(&type, sizeof(type));
+        switch (type)
+        {
+            case eFbxChar: hash_value<FbxChar>(hash, p); break;
+            case eFbxUChar: hash_value<FbxUChar>(hash, p); break;
+            case eFbxShort: hash_value<FbxShort>(hash, p); break;
+            case eFbxUShort: hash_value<FbxUShort>(hash, p); break;
+            case eFbxUInt: hash_value<FbxUInt>(hash, p); break;
+            case eFbxLongLong: hash_value<FbxLongLong>(hash, p); break;
+            case eFbxULongLong: hash_value<FbxULongLong>(hash, p); break;
+            case eFbxBool: hash_value<FbxBool>(hash, p); break;
+            case eFbxInt: hash_value<FbxInt>(hash, p); break;
+            case eFbxEnum:
+            case eFbxEnumM: hash_value<FbxEnum>(hash, p); break;
+            case eFbxFloat: hash_value<FbxFloat>(hash, p); break;
+            case eFbxDouble: hash_value<FbxDouble>(hash, p); break;
+            case eFbxDouble2: hash_value<FbxDouble2>(hash, p); break;
+            case eFbxDouble3: hash_value<FbxDouble3>(hash, p); break;
+            case eFbxDouble4: hash_value<FbxDouble4>(hash, p); break;
+            case eFbxDouble4x4: hash_value<FbxDouble4x4>(hash, p); break;
+            case eFbxTime: { auto value = p.Get<FbxTime>().Get(); hash.update(&value, sizeof(value)); break; }
+            case eFbxString: hash.update(std::string(p.Get<FbxString>().Buffer())); break;
+            case eFbxUndefined:
+            case eFbxReference: break; // compounds and references, sources below
+            default: return false;
+        }
+        
+        // textures of material channels, already canonical when materials are hashed
+        auto count = p.GetSrcObjectCount();
+        hash.update(&count, sizeof(count));
+        for (auto i = 0; i < count; i++)
+        {
+            auto id = p.GetSrcObject(i)->GetUniqueID();
+            hash.update(&id, sizeof(id));
+        }
+    }
+    return true;
+}
+
+template<typename T>
+void hash_array(ContentHash &hash, FbxLayerElementArrayTemplate<T> &array)
+{
+    auto count = array.GetCount();
+    hash.update(&count, sizeof(count));
+    auto ptr = array.GetLocked((T *)nullptr, FbxLayerElementArray::eReadLock);
+    if (ptr == nullptr) { return; }
+    hash.update(ptr, count * sizeof(T));
+    array.Release(&ptr, (T *)nullptr);
+}
+
+template<typename T>
+void hash_element(ContentHash &hash, const FbxLayerElementTemplate<T> *element, bool direct = true)
+{
+    int header[3] = {element != nullptr, 0, 0};
+    if (element != nullptr)
+    {
+        header[1] = element->GetMappingMode();
+        header[2] = element->GetReferenceMode();
+    }
+    hash.update(header, sizeof(header));
+    if (element == nullptr) { return; }
+    
+    if (direct) { hash_array(hash, element->GetDirectArray()); }
+    if (element->GetReferenceMode() != FbxLayerElement::eDirect) { hash_array(hash, element->GetIndexArray()); }
+}
+
+// meshes without deformers, by control points, polygons and every layer element, false if the mesh can't be shared
+bool hash_mesh(ContentHash &hash, FbxMesh *mesh)
+{
+    if (mesh->GetDeformerCount() > 0) { return false; }
+    
+    auto points = mesh->GetControlPointsCount();
+    hash.update(&points, sizeof(points));
+    hash.update(mesh->GetControlPoints(), points * sizeof(FbxVector4));
+    
+    auto vertices = mesh->GetPolygonVertexCount();
+    hash.update(&vertices, sizeof(vertices));
+    hash.update(mesh->GetPolygonVertices(), vertices * sizeof(int));
+    
+    std::vector<int> sizes(mesh->GetPolygonCount());
+    for (auto i = 0; i < sizes.size(); i++) { sizes[i] = mesh->GetPolygonSize(i); }
+    hash.update(sizes.data(), sizes.size() * sizeof(int));
+    
+    for (auto n = 0; n < mesh->GetLayerCount(); n++)
+    {
+        auto layer = mesh->GetLayer(n);
+        if (layer->GetUserData() != nullptr) { return false; }
+        for (auto t = (int)FbxLayerElement::eTextureDiffuse; t < FbxLayerElement::eTypeCount; t++)
+        {
+            if (layer->GetLayerElementOfType((FbxLayerElement::EType)t) != nullptr) { return false; }
+        }
+        
+        hash_element(hash, layer->GetNormals());
+        hash_element(hash, layer->GetBinormals());
+        hash_element(hash, layer->GetTangents());
+        hash_element(hash, layer->GetVertexColors());
+        hash_element(hash, layer->GetSmoothing());
+        hash_element(hash, layer->GetPolygonGroups());
+        hash_element(hash, layer->GetVertexCrease());
+        hash_element(hash, layer->GetEdgeCrease());
+        hash_element(hash, layer->GetHole());
+        hash_element(hash, layer->GetVisibility());
+        hash_element(hash, layer->GetMaterials(), false); // indices into materials of the node
+        
+        auto sets = layer->GetUVSets();
+        for (auto i = 0; i < sets.GetCount(); i++)
+        {
+            hash.update(std::string(sets[i]->GetName()));
+            hash_element(hash, sets[i]);
+        }
+    }
+    
+    return hash_properties(hash, mesh);
+}
+
+// sources of the given kind on every destination of obj are reconnected in order with obj swapped for canonical,
+// destinations already holding canonical keep obj, which survives only then
+bool redirect(FbxObject *obj, FbxObject *canonical, const FbxCriteria &kind)
+{
+    std::vector<FbxProperty> targets;
+    for (auto i = 0; i < obj->GetDstPropertyCount(); i++)
+    {
+        auto property = obj->GetDstProperty(i);
+        if (FbxCast<FbxScene>(property.GetFbxObject()) != nullptr) { continue; }
+        targets.push_back(property);
+    }
+    
+    auto shared = true;
+    for (auto iter = targets.begin(); iter != targets.end(); iter++)
+    {
+        auto &property = *iter;
+        if (property.IsConnectedSrcObject(canonical)) { shared = false; continue; }
+        
+        std::vector<FbxObject *> sources;
+        for (auto i = 0; i < property.GetSrcObjectCount(kind); i++) { sources.push_back(property.GetSrcObject(kind, i)); }
+        for (auto s = sources.begin(); s != sources.end(); s++) { property.DisconnectSrcObject(*s); }
+        for (auto s = sources.begin(); s != sources.end(); s++) { property.ConnectSrcObject(*s == obj ? canonical : *s); }
+    }
+    
+    if (shared) { obj->Destroy(); }
+    return shared;
+}
+
+// identical file textures, then materials and meshes without deformers collapse into the first of each in scene order
+void deduplicate(FbxScene *scene)
+{
+    struct Kind
+    {
+        const char *name;
+        FbxClassId type;
+        bool (*hash)(ContentHash &hash, FbxObject *obj);
+    };
+    
+    const Kind kinds[] =
+    {
+        {"textures", FbxFileTexture::ClassId, [](ContentHash &hash, FbxObject *obj)
+        {
+            auto texture = FbxCast<FbxFileTexture>(obj);
+            std::string filename = texture->GetFileName();
+            hash.update(filename);
+            ContentHash::file(filename, hash);
+            return hash_properties(hash, obj);
+        }},
+        {"materials", FbxSurfaceMaterial::ClassId, [](ContentHash &hash, FbxObject *obj)
+        {
+            hash.update(std::string(obj->GetClassId().GetName()));
+            return hash_properties(hash, obj);
+        }},
+        {"meshes", FbxMesh::ClassId, [](ContentHash &hash, FbxObject *obj)
+        {
+            return obj->GetClassId() == FbxMesh::ClassId && hash_mesh(hash, FbxCast<FbxMesh>(obj));
+        }},
+    };
+    
+    for (auto k = 0; k < sizeof(kinds) / sizeof(Kind); k++)
+    {
+        auto &kind = kinds[k];
+        auto criteria = FbxCriteria::ObjectType(kind.type);
+        
+        std::vector<FbxObject *> objects;
+        for (auto i = 0; i < scene->GetSrcObjectCount(criteria); i++) { objects.push_back(scene->GetSrcObject(criteria, i)); }
+        
+        std::unordered_map<uint64_t, FbxObject *> canonicals;
+        auto removed = 0;
+        for (auto iter = objects.begin(); iter != objects.end(); iter++)
+        {
+            ContentHash hash;
+            if (!kind.hash(hash, *iter)) { continue; }
+            
+            auto match = canonicals.insert(std::make_pair(hash.digest(), *iter));
+            if (match.second) { continue; }
+            if (redirect(*iter, match.first->second, criteria)) { ++removed; }
+        }
+        
+        if (removed > 0) { output("[-] %d %s shared\n", removed, kind.name); }
+    }
+}
+
+// world transform of a mesh node with its geometric offset baked into points, directions and normals
+class BakeTransform
+{
+    FbxAMatrix __world;
+    FbxAMatrix __inverse;
+    bool __mirrored;
+    
+public:
+    BakeTransform(FbxNode *node)
+    {
+        FbxAMatrix geometry(node->GetGeometricTranslation(FbxNode::eSourcePivot),
+                            node->GetGeometricRotation(FbxNode::eSourcePivot),
+                            node->GetGeometricScaling(FbxNode::eSourcePivot));
+        __world = node->EvaluateGlobalTransform() * geometry;
+        __inverse = __world.Inverse();
+        
+        auto &m = __world;
+        __mirrored = m[0][0] * (m[1][1] * m[2][2] - m[1][2] * m[2][1]) - m[0][1] * (m[1][0] * m[2][2] - m[1][2] * m[2][0]) + m[0][2] * (m[1][0] * m[2][1] - m[1][1] * m[2][0]) < 0;
+    }
+    
+    // a negative scale flips winding, polygons are then emitted in reverse
+    bool mirrored() const { return __mirrored; }
+    
+    FbxVector4 point(const FbxVector4 &v) const
+    {
+        auto p = __world.MultT(FbxVector4(v[0], v[1], v[2], 1));
+        p[3] = 1;
+        return p;
+    }
+    
+    // tangents and binormals follow the linear part, w is the binormal sign and flips along with the handedness
+    FbxVector4 direction(const FbxVector4 &v) const
+    {
+        auto &m = __world;
+        FbxVector4 d(v[0] * m[0][0] + v[1] * m[1][0] + v[2] * m[2][0],
+                     v[0] * m[0][1] + v[1] * m[1][1] + v[2] * m[2][1],
+                     v[0] * m[0][2] + v[1] * m[1][2] + v[2] * m[2][2], 0);
+        d.Normalize();
+        d[3] = __mirrored ? -v[3] : v[3];
+        return d;
+    }
+    
+    // inverse transpose of the linear part, so normals stay perpendicular under non-uniform scale
+    FbxVector4 normal(const FbxVector4 &v) const
+    {
+        auto &m = __inverse;
+        FbxVector4 n(m[0][0] * v[0] + m[0][1] * v[1] + m[0][2] * v[2],
+                     m[1][0] * v[0] + m[1][1] * v[1] + m[1][2] * v[2],
+                     m[2][0] * v[0] + m[2][1] * v[1] + m[2][2] * v[2], 0);
+        n.Normalize();
+        n[3] = v[3];
+        return n;
+    }
+};
+
+template<typename T>
+bool sampled(const FbxLayerElementTemplate<T> *element)
+{
+    if (element == nullptr) { return true; }
+    switch (element->GetMappingMode())
+    {
+        case FbxLayerElement::eByControlPoint:
+        case FbxLayerElement::eByPolygonVertex:
+        case FbxLayerElement::eByPolygon:
+        case FbxLayerElement::eAllSame: return true;
+        default: return false;
+    }
+}
+
+// value of an element at polygon, polygon vertex and control point, whatever its mapping and reference
+template<typename T>
+T sample(const FbxLayerElementTemplate<T> *element, int polygon, int vertex, int point)
+{
+    int index = 0;
+    switch (element->GetMappingMode())
+    {
+        case FbxLayerElement::eByControlPoint: index = point; break;
+        case FbxLayerElement::eByPolygonVertex: index = vertex; break;
+        case FbxLayerElement::eByPolygon: index = polygon; break;
+        default: break;
+    }
+    if (element->GetReferenceMode() != FbxLayerElement::eDirect) { index = element->GetIndexArray().GetAt(index); }
+    return element->GetDirectArray().GetAt(index);
+}
+
+template<typename T>
+void prepare(FbxLayerElementTemplate<T> *element, const FbxLayerElement *source)
+{
+    element->SetMappingMode(FbxLayerElement::eByPolygonVertex);
+    element->SetReferenceMode(FbxLayerElement::eDirect);
+    if (source != nullptr) { element->SetName(source->GetName()); }
+}
+
+bool animated(FbxNode *node)
+{
+    for (; node != nullptr; node = node->GetParent())
+    {
+        if (node->LclTranslation.GetCurveNode() || node->LclRotation.GetCurveNode() || node->LclScaling.GetCurveNode()) { return true; }
+    }
+    return false;
+}
+
+// static mesh nodes with one material and a single layer of normals, tangents, binormals, colors and uvs can be batched,
+// layout names those elements so that only meshes building the same vertex go together
+bool batchable(FbxNode *node, std::string &layout)
+{
+    auto mesh = node->GetMesh();
+    if (mesh == nullptr || node->GetNodeAttributeCount() != 1 || node->GetMaterialCount() != 1) { return false; }
+    if (mesh->GetDeformerCount() > 0 || mesh->GetLayerCount() > 1 || animated(node)) { return false; }
+    
+    layout.clear();
+    auto layer = mesh->GetLayer(0);
+    if (layer == nullptr) { return true; }
+    
+    // smoothing is dropped with normals baked, anything else has no meaning across meshes
+    const FbxLayerElement::EType kept[] =
+    {
+        FbxLayerElement::eNormal, FbxLayerElement::eBiNormal, FbxLayerElement::eTangent, FbxLayerElement::eVertexColor,
+        FbxLayerElement::eUV, FbxLayerElement::eMaterial, FbxLayerElement::eSmoothing
+    };
+    for (auto t = (int)FbxLayerElement::eNormal; t < FbxLayerElement::eTypeCount; t++)
+    {
+        auto type = (FbxLayerElement::EType)t;
+        if (std::find(std::begin(kept), std::end(kept), type) != std::end(kept)) { continue; }
+        if (layer->GetLayerElementOfType(type) != nullptr) { return false; }
+    }
+    if (layer->GetSmoothing() != nullptr && layer->GetNormals() == nullptr) { return false; }
+    
+    auto materials = layer->GetMaterials();
+    if (materials != nullptr && materials->GetMappingMode() != FbxLayerElement::eAllSame)
+    {
+        auto &indices = materials->GetIndexArray();
+        for (auto i = 0; i < indices.GetCount(); i++)
+        {
+            if (indices.GetAt(i) != 0) { return false; }
+        }
+    }
+    
+    if (!sampled(layer->GetNormals()) || !sampled(layer->GetTangents()) || !sampled(layer->GetBinormals()) || !sampled(layer->GetVertexColors())) { return false; }
+    if (layer->GetNormals()) { layout += "n"; }
+    if (layer->GetTangents()) { layout += "t"; }
+    if (layer->GetBinormals()) { layout += "b"; }
+    if (layer->GetVertexColors()) { layout += "c"; }
+    
+    auto sets = layer->GetUVSets();
+    for (auto i = 0; i < sets.GetCount(); i++)
+    {
+        if (!sampled(sets[i])) { return false; }
+        layout += "|";
+        layout += sets[i]->GetName();
+    }
+    return true;
+}
+
+// draw calls of the scene as an engine issues them, one per material of every mesh node
+int drawcalls(FbxNode *node)
+{
+    auto count = node->GetMesh() != nullptr ? std::max(1, node->GetMaterialCount()) : 0;
+    for (auto i = 0; i < node->GetChildCount(); i++) { count += drawcalls(node->GetChild(i)); }
+    return count;
+}
+
+struct Batch
+{
+    FbxSurfaceMaterial *material;
+    std::vector<FbxNode *> nodes;
+    int vertices = 0;
+};
+
+// one mesh in scene space from all nodes of a batch, every element remapped by polygon vertex
+FbxNode *bake(FbxScene *scene, const Batch &batch, const std::string &name)
+{
+    auto points = 0, polygons = 0, vertices = 0;
+    for (auto iter = batch.nodes.begin(); iter != batch.nodes.end(); iter++)
+    {
+        auto mesh = (*iter)->GetMesh();
+        points += mesh->GetControlPointsCount();
+        polygons += mesh->GetPolygonCount();
+        vertices += mesh->GetPolygonVertexCount();
+    }
+    
+    auto mesh = FbxMesh::Create(scene, name.c_str());
+    mesh->InitControlPoints(points);
+    mesh->ReservePolygonCount(polygons);
+    mesh->ReservePolygonVertexCount(vertices);
+    
+    auto layer = batch.nodes[0]->GetMesh()->GetLayer(0);
+    FbxGeometryElementNormal *normals = nullptr;
+    FbxGeometryElementTangent *tangents = nullptr;
+    FbxGeometryElementBinormal *binormals = nullptr;
+    FbxGeometryElementVertexColor *colors = nullptr;
+    std::vector<FbxGeometryElementUV *> uvs;
+    if (layer != nullptr)
+    {
+        if (layer->GetNormals()) { prepare(normals = mesh->CreateElementNormal(), layer->GetNormals()); }
+        if (layer->GetTangents()) { prepare(tangents = mesh->CreateElementTangent(), layer->GetTangents()); }
+        if (layer->GetBinormals()) { prepare(binormals = mesh->CreateElementBinormal(), layer->GetBinormals()); }
+        if (layer->GetVertexColors()) { prepare(colors = mesh->CreateElementVertexColor(), layer->GetVertexColors()); }
+        
+        auto sets = layer->GetUVSets();
+        for (auto i = 0; i < sets.GetCount(); i++)
+        {
+            uvs.push_back(mesh->CreateElementUV(sets[i]->GetName()));
+            prepare(uvs.back(), sets[i]);
+        }
+    }
+    
+    auto materials = mesh->CreateElementMaterial();
+    materials->SetMappingMode(FbxLayerElement::eAllSame);
+    materials->SetReferenceMode(FbxLayerElement::eIndexToDirect);
+    materials->GetIndexArray().Add(0);
+    
+    auto target = mesh->GetControlPoints();
+    auto offset = 0;
+    for (auto iter = batch.nodes.begin(); iter != batch.nodes.end(); iter++)
+    {
+        auto source = (*iter)->GetMesh();
+        BakeTransform transform(*iter);
+        auto mirrored = transform.mirrored();
+        
+        auto count = source->GetControlPointsCount();
+        auto controls = source->GetControlPoints();
+        for (auto i = 0; i < count; i++) { target[offset + i] = transform.point(controls[i]); }
+        
+        auto element = source->GetLayer(0);
+        auto sets = element != nullptr ? element->GetUVSets() : FbxArray<const FbxLayerElementUV *>();
+        for (auto p = 0; p < source->GetPolygonCount(); p++)
+        {
+            auto start = source->GetPolygonVertexIndex(p);
+            auto size = source->GetPolygonSize(p);
+            mesh->BeginPolygon();
+            for (auto k = 0; k < size; k++)
+            {
+                auto position = mirrored ? size - 1 - k : k;
+                auto vertex = start + position;
+                auto point = source->GetPolygonVertex(p, position);
+                mesh->AddPolygon(offset + point);
+                
+                if (normals) { normals->GetDirectArray().Add(transform.normal(sample(element->GetNormals(), p, vertex, point))); }
+                if (tangents) { tangents->GetDirectArray().Add(transform.direction(sample(element->GetTangents(), p, vertex, point))); }
+                if (binormals) { binormals->GetDirectArray().Add(transform.direction(sample(element->GetBinormals(), p, vertex, point))); }
+                if (colors) { colors->GetDirectArray().Add(sample(element->GetVertexColors(), p, vertex, point)); }
+                for (auto i = 0; i < uvs.size(); i++) { uvs[i]->GetDirectArray().Add(sample(sets[i], p, vertex, point)); }
+            }
+            mesh->EndPolygon();
+        }
+        offset += count;
+    }
+    
+    auto node = FbxNode::Create(scene, name.c_str());
+    node->SetNodeAttribute(mesh);
+    node->AddMaterial(batch.material);
+    scene->GetRootNode()->AddChild(node);
+    return node;
+}
+
+// takes the mesh and material off a baked node, which goes away unless it still parents other nodes
+void strip(FbxNode *node, FbxSurfaceMaterial *material)
+{
+    auto mesh = node->GetMesh();
+    node->RemoveNodeAttribute(mesh);
+    node->RemoveMaterial(material);
+    if (mesh->GetDstObjectCount<FbxNode>() == 0) { mesh->Destroy(); }
+    
+    if (node->GetChildCount() == 0)
+    {
+        node->GetParent()->RemoveChild(node);
+        node->Destroy();
+    }
+}
+
+// ?batch=1 merges static meshes sharing a material and vertex layout into meshes of up to ?batchvertices polygon vertices,
+// with ?batchcell=S only meshes whose bounds center falls in the same S sized cell in scene units, so culling still works
+void batch(FbxScene *scene, int limit, double cell)
+{
+    std::vector<FbxNode *> nodes;
+    std::vector<FbxNode *> stack(1, scene->GetRootNode());
+    while (!stack.empty())
+    {
+        auto node = stack.back();
+        stack.pop_back();
+        nodes.push_back(node);
+        for (auto i = node->GetChildCount() - 1; i >= 0; i--) { stack.push_back(node->GetChild(i)); }
+    }
+    
+    // batches of a key in order of first appearance, the last one of each key is still open
+    std::vector<Batch> batches;
+    std::map<std::string, size_t> open;
+    auto before = drawcalls(scene->GetRootNode());
+    for (auto iter = nodes.begin(); iter != nodes.end(); iter++)
+    {
+        auto node = *iter;
+        std::string layout;
+        if (!batchable(node, layout)) { continue; }
+        
+        auto vertices = node->GetMesh()->GetPolygonVertexCount();
+        if (vertices == 0 || vertices > limit) { continue; }
+        
+        auto material = node->GetMaterial(0);
+        char key[128];
+        snprintf(key, sizeof(key), "%llu:", (unsigned long long)material->GetUniqueID());
+        layout = key + layout;
+        if (cell > 0)
+        {
+            BakeTransform transform(node);
+            auto mesh = node->GetMesh();
+            FbxVector4 lower, upper;
+            for (auto i = 0; i < mesh->GetControlPointsCount(); i++)
+            {
+                auto p = transform.point(mesh->GetControlPointAt(i));
+                for (auto a = 0; a < 3; a++)
+                {
+                    if (i == 0 || p[a] < lower[a]) { lower[a] = p[a]; }
+                    if (i == 0 || p[a] > upper[a]) { upper[a] = p[a]; }
+                }
+            }
+            snprintf(key, sizeof(key), ":%lld,%lld,%lld",
+                     (long long)floor((lower[0] + upper[0]) / 2 / cell),
+                     (long long)floor((lower[1] + upper[1]) / 2 / cell),
+                     (long long)floor((lower[2] + upper[2]) / 2 / cell));
+            layout += key;
+        }
+        
+        auto match = open.find(layout);
+        if (match == open.end() || batches[match->second].vertices + vertices > limit)
+        {
+            batches.emplace_back();
+            batches.back().material = material;
+            open[layout] = batches.size() - 1;
+        }
+        
+        auto &batch = batches[open[layout]];
+        batch.nodes.push_back(node);
+        batch.vertices += vertices;
+    }
+    
+    auto count = 0;
+    for (auto iter = batches.begin(); iter != batches.end(); iter++)
+    {
+        if (iter->nodes.size() < 2) { continue; }
+        bake(scene, *iter, std::string("Batch_") + iter->material->GetName() + "_" + std::to_string(count++));
+        for (auto n = iter->nodes.begin(); n != iter->nodes.end(); n++) { strip(*n, iter->material); }
     }
     
-    scene->DisconnectAllSrcObject();
+    output("[*] draw calls %d => %d, %d batches\n", before, drawcalls(scene->GetRootNode()), count);
 }
 
 int main(int argc, const char * argv[])
 {
-    if (argc <= 1) {return 1;}
+    CommandOptions options(argc, argv);
+    auto &files = options.files;
+    if (files.empty()) {return 1;}
+    
+    // --format, --fbx-version, --compress-level and --compress-minsize
+    ArgumentOptions args(files[0]);
+    args.inherit(options.defaults);
     
     FbxPtr<FbxManager> manager;
     manager->SetIOSettings(FbxIOSettings::Create(manager, IOSROOT));
@@ -62,21 +698,100 @@ int main(int argc, const char * argv[])
         FbxSystemUnit::m.ConvertScene(scene, options);
     }
     
-    std::string filename(argv[1]);
+    std::string filename = archive::workpath(args.filename);
     auto dot = filename.rfind('.');
     if (dot == std::string::npos) { return 2; }
     
     std::string savename = filename.substr(0, dot) + "_cat" + filename.substr(dot);
     
+    BufferedFileStream target;
     FbxPtr<FbxExporter> exporter(FbxExporter::Create(manager, ""));
-    if (!exporter->Initialize(savename.c_str(), -1, manager->GetIOSettings())) { return 3; }
+    if (!initialize(exporter, target, savename, manager->GetIOSettings(), ExportOptions(args))) { return 3; }
     
-    for (auto i = 1; i < argc; i++)
+    // ?threads=N inputs are parsed at a time, at most twice as many scenes wait in memory for the merge
+    std::string value;
+    auto threads = args.get("threads", value) ? atoi(value.c_str()) : 0;
+    if (threads <= 0) { threads = std::max(1, (int)std::thread::hardware_concurrency()); }
+    threads = std::min(threads, (int)files.size());
+    const int limit = threads * 2;
+    
+    std::vector<SourceScene> sources(files.size());
+    std::mutex mutex;
+    std::condition_variable changed;
+    int merged = 0;
+    auto failures = 0;
+    RetainedManagers retained;
     {
-        printf("[%d/%d] %s\n", i, argc - 1, argv[i]);
-        merge(argv[i], scene);
+        WorkerPool<void> pool(threads);
+        for (auto i = 0; i < files.size(); i++)
+        {
+            pool.submit([&, i](void *)
+            {
+                {
+                    std::unique_lock<std::mutex> lock(mutex);
+                    changed.wait(lock, [&]{ return i < merged + limit; });
+                }
+                
+                load(ArgumentOptions(files[i]).filename, sources[i]);
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    sources[i].done = true;
+                }
+                changed.notify_all();
+            });
+        }
+        
+        for (auto i = 0; i < files.size(); i++)
+        {
+            auto &source = sources[i];
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                changed.wait(lock, [&]{ return source.done; });
+            }
+            
+            // a failed input fails the whole merge, later ones are still drained so the workers can finish
+            auto detached = true;
+            auto filename = ArgumentOptions(files[i]).filename;
+            output("[%d/%d] %s\n", i + 1, (int)files.size(), filename.c_str());
+            if (source.scene == nullptr)
+            {
+                output("[E] %s unable to import\n", filename.c_str());
+                ++failures;
+            }
+            else if (failures == 0 && !merge(source, scene, detached))
+            {
+                output("[E] %s unable to merge\n", filename.c_str());
+                ++failures;
+            }
+            
+            if (detached)
+            {
+                std::lock_guard<std::mutex> lock(sdk());
+                source.manager->Destroy();
+            }
+            else { retained.add(source.manager); }
+            source.manager = nullptr;
+            source.scene = nullptr;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                ++merged;
+            }
+            changed.notify_all();
+        }
+        pool.join();
     }
-
+    if (failures > 0) { return 5; }
+    
+    // ?dedup=0 keeps every copy
+    if (!args.get("dedup", value) || atoi(value.c_str()) != 0) { deduplicate(scene); }
+    
+    if (args.get("batch", value) && atoi(value.c_str()) != 0)
+    {
+        auto limit = args.get("batchvertices", value) ? atoi(value.c_str()) : 65535;
+        auto cell = args.get("batchcell", value) ? atof(value.c_str()) : 0;
+        batch(scene, limit, cell);
+    }
+    
     if (!exporter->Export(scene)) { return 4; }
     
     std::cout << "[+] " << savename << std::endl;
@@ -7,18 +7,36 @@
 //
 
 #include <iostream>
+#include <map>
+#include <mutex>
+#include <set>
 #include <fbxsdk.h>
 #include <fbxsdk/fileio/fbxiosettings.h>
 #include <fbxsdk/core/fbxdatatypes.h>
 
 #include <arguments.h>
+#include <workers.h>
+#include <cache.h>
+#include <streams.h>
+#include <driver.h>
+#include <fbxascii.h>
+#include <fbxbinary.h>
+#include <profile.h>
 
 struct FileOptions: public ArgumentOptions
 {
     std::string extension;
     bool unit;
+    bool binary;
+    bool media;
+    bool bench;
+    int level = 0;   // zlib level of arrays written by ?binary, ?zlib or ?compresslevel
+    int threshold = 128; // arrays of fewer bytes stay raw, ?compressmin
+    int threads = 0; // parsing arrays of ?binary, 0 for cores left per job
     
-    FileOptions(std::string file): ArgumentOptions(file)
+    FileOptions(std::string file): FileOptions(ArgumentOptions(file)) {}
+    
+    FileOptions(const ArgumentOptions &args): ArgumentOptions(args)
     {
         if (!get("type", extension))
         {
@@ -26,17 +44,34 @@ struct FileOptions: public ArgumentOptions
         }
         
         unit = get("unit");
+        binary = get("binary");
+        media = get("media");
+        bench = get("exportbench");
+        
+        std::string value;
+        if (get("compresslevel", value)) { level = atoi(value.c_str()); }
+        if (get("compressmin", value)) { threshold = std::max(0, atoi(value.c_str())); }
+        if (get("zlib", value)) { level = value.empty() ? 6 : atoi(value.c_str()); } // zlib's default level, as fbxgen takes it
+        level = std::min(9, std::max(0, level));
+        if (get("threads", value)) { threads = atoi(value.c_str()); }
     }
 };
 
 #include <sys/stat.h>
 
-bool process(FileOptions &fo, FbxManager *manager, std::string &error)
+std::string createWorkspace(const FileOptions &fo)
 {
-    auto filepath = fo.filename;
-    auto dot = filepath.rfind('.');
-    std::string workspace = filepath.substr(0, dot) + ".fbm";
+    auto filepath = archive::workpath(fo.filename);
+    std::string workspace = filepath.substr(0, filepath.rfind('.')) + ".fbm";
     mkdir(workspace.c_str(), 0777);
+    return workspace;
+}
+
+std::string destination(const FileOptions &fo, const std::string &extension)
+{
+    auto filepath = archive::workpath(fo.filename);
+    auto dot = filepath.rfind('.');
+    auto workspace = createWorkspace(fo);
     
     std::string name;
     auto sep = filepath.rfind('/');
@@ -49,30 +84,234 @@ bool process(FileOptions &fo, FbxManager *manager, std::string &error)
         name = filepath.substr(sep + 1, dot - sep - 1);
     }
     
-    std::string savename = workspace + "/" + name + "." + fo.extension;
+    return workspace + "/" + name + "." + extension;
+}
+
+// ?binary transcodes ASCII FBX to binary FBX records without an SDK import and export
+bool transcode(FileOptions &fo, std::string &error)
+{
+    AsciiDocument document;
+    if (!document.open(fo.filename, error) || !document.parse(error)) { return false; }
+    if (!document.decode(fo.threads, fo.level, fo.threshold, error)) { return false; }
     
-    // read
-    auto importer = FbxImporter::Create(manager, "");
-    if (!importer->Initialize(filepath.c_str(), -1, manager->GetIOSettings()))
+    auto savename = destination(fo, "fbx");
+    if (!document.write(savename, error)) { return false; }
+    
+    produced(savename);
+    output(">>> %s\n", savename.c_str());
+    return true;
+}
+
+// embedded media already written in this run, by content, duplicates become hard links of the first copy
+class MediaStore
+{
+    std::map<std::pair<uint64_t, uint64_t>, std::string> __files; // size and hash
+    std::mutex __mutex;
+    
+    // bytes straight from the mapped FBX, the only copy is into the page cache
+    static bool write(const std::string &filename, const char *data, size_t size)
     {
-        error = importer->GetStatus().GetErrorString();
+        unlink(filename.c_str()); // may be a link to media of another file
+        auto fd = ::open(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0) { return false; }
+        
+        size_t done = 0;
+        while (done < size)
+        {
+            auto count = ::write(fd, data + done, size - done);
+            if (count < 0 && errno == EINTR) { continue; }
+            if (count <= 0) { break; }
+            done += count;
+        }
+        return ::close(fd) == 0 && done == size;
+    }
+    
+    // hashes only point at candidates, the first copy is compared before linking
+    static bool same(const std::string &filename, const char *data, size_t size)
+    {
+        MappedFile file;
+        return file.open(filename) && file.size() == size && memcmp(file.data(), data, size) == 0;
+    }
+
+public:
+    // true if the file was linked to an earlier copy
+    bool save(const std::string &filename, const char *data, size_t size, bool &linked)
+    {
+        auto key = std::make_pair((uint64_t)size, ContentHash().update(data, size).digest());
+        
+        std::string origin;
+        {
+            std::lock_guard<std::mutex> lock(__mutex);
+            auto match = __files.find(key);
+            if (match != __files.end()) { origin = match->second; }
+        }
+        
+        linked = false;
+        if (!origin.empty() && origin != filename && same(origin, data, size))
+        {
+            unlink(filename.c_str());
+            linked = link(origin.c_str(), filename.c_str()) == 0;
+            if (linked) { return true; }
+        }
+        
+        if (!write(filename, data, size)) { return false; }
+        
+        std::lock_guard<std::mutex> lock(__mutex);
+        __files.insert(std::make_pair(key, filename));
+        return true;
+    }
+};
+
+MediaStore media;
+
+// file name of a Video, last path component of RelativeFilename or Filename, both / and \ separated
+std::string medianame(const BinaryDocument &document, const BinaryRecord &video, const std::string &fallback)
+{
+    const char *fields[] = {"RelativeFilename", "Filename"};
+    for (auto i = 0; i < 2; i++)
+    {
+        BinaryProperty value;
+        if (!fbxbinary::value(document, video, fields[i], value)) { continue; }
+        
+        auto path = value.string();
+        auto sep = path.find_last_of("/\\");
+        auto name = sep == std::string::npos ? path : path.substr(sep + 1);
+        if (!name.empty()) { return name; }
+    }
+    return fallback;
+}
+
+// ?media writes Video/Content of binary FBX into the .fbm workspace without an SDK import
+bool extract(FileOptions &fo, std::string &error)
+{
+    BinaryDocument document;
+    if (!document.open(fo.filename, error)) { return false; }
+    
+    BinaryRecord objects;
+    std::vector<BinaryRecord> records;
+    if (!document.find("Objects", objects)) { return true; }
+    if (!document.children(objects, records))
+    {
+        error = "broken objects";
         return false;
     }
     
-    auto scene = FbxScene::Create(manager, "Scene");
-    if (!importer->Import(scene))
+    auto workspace = createWorkspace(fo);
+    
+    std::set<std::string> names;
+    std::vector<BinaryProperty> properties;
+    auto count = 0, linked = 0;
+    for (auto iter = records.begin(); iter != records.end(); iter++)
+    {
+        BinaryProperty content;
+        if (!iter->is("Video") || !fbxbinary::value(document, *iter, "Content", content)) { continue; }
+        if (content.type != 'R' || content.length == 0) { continue; }
+        
+        std::string fallback = "video";
+        if (document.properties(*iter, properties) && properties.size() > 1) { fallback = fbxbinary::name(properties[1]); }
+        auto name = medianame(document, *iter, fallback);
+        
+        // different media under one name within a file are numbered as name_1.ext, name_2.ext...
+        auto unique = name;
+        auto dot = name.rfind('.');
+        for (auto n = 1; !names.insert(unique).second; n++)
+        {
+            unique = dot == std::string::npos ? name + "_" + std::to_string(n) : name.substr(0, dot) + "_" + std::to_string(n) + name.substr(dot);
+        }
+        
+        auto filename = workspace + "/" + unique;
+        bool link;
+        if (!media.save(filename, content.data, content.length, link))
+        {
+            error = filename + " unable to write";
+            return false;
+        }
+        
+        ++count;
+        if (link) { ++linked; }
+        produced(filename);
+        output(">>> %s%s\n", filename.c_str(), link ? " (linked)" : "");
+    }
+    
+    tally("media", count);
+    tally("linked", linked);
+    return true;
+}
+
+bool load(FileOptions &fo, FbxManager *manager, FbxScene *scene, std::string &error)
+{
+    MappedFileStream source;
+    FbxAutoDestroyPtr<FbxImporter> importer(FbxImporter::Create(manager, ""));
+    if (!initialize(importer, source, fo.filename, manager->GetIOSettings()) || !importer->Import(scene))
     {
         error = importer->GetStatus().GetErrorString();
         return false;
     }
+    return true;
+}
+
+// variants of ?exportbench, compression levels only matter to binary
+const struct { const char *name; const char *format; int level; } benchmarks[] = {
+    {"ascii", "ascii", 0},
+    {"binary0", "binary", 0},
+    {"binary1", "binary", 1},
+    {"binary6", "binary", 6},
+    {"binary9", "binary", 9}
+};
+
+// ?exportbench imports once and exports the scene under every variant, with ?fbxversion and ?compressmin as given,
+// sizes and times are tallied per variant for the totals over all files
+bool benchmark(FileOptions &fo, FbxManager *manager, std::string &error)
+{
+    FbxAutoDestroyPtr<FbxScene> scene(FbxScene::Create(manager, "Scene"));
+    if (!load(fo, manager, scene, error)) { return false; }
+    
+    auto savename = destination(fo, "bench.fbx");
+    for (auto i = 0; i < sizeof(benchmarks) / sizeof(benchmarks[0]); i++)
+    {
+        auto &variant = benchmarks[i];
+        ExportOptions options(fo);
+        options.format = variant.format;
+        options.level = variant.level;
+        
+        Stopwatch watch;
+        {
+            BufferedFileStream target;
+            FbxAutoDestroyPtr<FbxExporter> exporter(FbxExporter::Create(manager, ""));
+            if (!initialize(exporter, target, savename, manager->GetIOSettings(), options) || !exporter->Export(scene))
+            {
+                error = exporter->GetStatus().GetErrorString();
+                unlink(savename.c_str());
+                return false;
+            }
+        }
+        auto elapsed = watch.elapsed();
+        
+        struct stat st;
+        auto size = stat(savename.c_str(), &st) == 0 ? (long long)st.st_size : 0;
+        unlink(savename.c_str());
+        
+        output("[exportbench] %-8s size=%lld time=%.3fs\n", variant.name, size, elapsed);
+        tally(std::string(variant.name) + ".bytes", size);
+        tally(std::string(variant.name) + ".ms", (long long)(elapsed * 1000));
+    }
+    return true;
+}
+
+bool process(FileOptions &fo, FbxManager *manager, std::string &error)
+{
+    auto savename = destination(fo, fo.extension);
     
-    importer->Destroy();
+    // read
+    FbxAutoDestroyPtr<FbxScene> scene(FbxScene::Create(manager, "Scene"));
+    if (!load(fo, manager, scene, error)) { return false; }
     
     // export
     manager->GetIOSettings()->SetBoolProp(EXP_FBX_EMBEDDED, true);
     
-    auto exporter = FbxExporter::Create(manager, "");
-    if (!exporter->Initialize(savename.c_str(), -1, manager->GetIOSettings()))
+    BufferedFileStream target;
+    FbxAutoDestroyPtr<FbxExporter> exporter(FbxExporter::Create(manager, ""));
+    if (!initialize(exporter, target, savename, manager->GetIOSettings(), ExportOptions(fo)))
     {
         error = exporter->GetStatus().GetErrorString();
         return false;
@@ -99,29 +338,71 @@ bool process(FileOptions &fo, FbxManager *manager, std::string &error)
         return false;
     }
     
-    printf(">>> %s\n", savename.c_str());
+    produced(savename);
+    output(">>> %s\n", savename.c_str());
     return true;
 }
 
 int main(int argc, const char * argv[])
 {
-    if (argc <= 1) {return 1;}
-    
-    FbxManager* manager = FbxManager::Create();
-    manager->SetIOSettings(FbxIOSettings::Create(manager, IOSROOT));
+    CommandOptions options(argc, argv);
+    memory::install();
     
-    for (auto i = 1; i < argc; i++)
+    ToolDriver<FbxManager> tool;
+    tool.name = "fbxconvert";
+    tool.version = FBXTOOLS_VERSION " " FBXSDK_VERSION_STRING;
+    tool.create = []
+    {
+        FbxManager* manager = FbxManager::Create();
+        manager->SetIOSettings(FbxIOSettings::Create(manager, IOSROOT));
+        return manager;
+    };
+    tool.destroy = [](FbxManager *manager)
     {
-        FileOptions fo(argv[i]);
-        printf("[%d/%d] %s\n", i, argc - 1, argv[i]);
+        manager->Destroy();
+    };
+    tool.announce = [](ArgumentOptions &args, int i, int count)
+    {
+        output("[%d/%d] %s\n", i + 1, count, args.filename.c_str());
+    };
+    tool.process = [&](FbxManager *manager, ArgumentOptions &args)
+    {
+        FileOptions fo(args);
+        if (fo.threads <= 0) { fo.threads = std::max(1, (int)std::thread::hardware_concurrency() / options.jobs); }
+        
         std::string error;
-        if (!process(fo, manager, error))
+        auto success = false;
+        if (fo.bench) { success = benchmark(fo, manager, error); }
+        else if (fo.media) { success = extract(fo, error); }
+        else if (fo.binary) { success = transcode(fo, error); }
+        else { success = process(fo, manager, error); }
+        if (!success)
+        {
+            output("[E] %s\n", error.c_str());
+        }
+        output("\n");
+        return success;
+    };
+    
+    std::map<std::string, long long> totals;
+    std::mutex mutex;
+    tool.finished = [&](int i, ArgumentOptions &args, JobRecord &record)
+    {
+        if (!FileOptions(args).bench) { return; }
+        std::lock_guard<std::mutex> lock(mutex);
+        for (auto iter = record.counters.begin(); iter != record.counters.end(); iter++) { totals[iter->first] += iter->second; }
+        totals["files"]++;
+    };
+    
+    auto result = drive(tool, options);
+    if (totals["files"] > 1)
+    {
+        for (auto i = 0; i < sizeof(benchmarks) / sizeof(benchmarks[0]); i++)
         {
-            printf("[E] %s\n", error.c_str());
+            std::string name(benchmarks[i].name);
+            printf("[exportbench] %lld files %-8s size=%lld time=%.3fs\n", totals["files"], name.c_str(), totals[name + ".bytes"], totals[name + ".ms"] / 1000.0);
         }
-        printf("\n");
     }
     
-    manager->Destroy();
-    return 0;
+    return result;
 }
@@ -16,17 +16,24 @@
 #include <fstream>
 #include <vector>
 #include <map>
+#include <memory>
 #include <assert.h>
 
 #include <arguments.h>
 #include <serialize.h>
+#include <workers.h>
+#include <cache.h>
+#include <driver.h>
+#include <profile.h>
+#include <streams.h>
+#include <conversion.h>
 
 class FileOptions;
 std::string createWorkspace(FileOptions &fo);
 std::string touch(FileOptions &fo, FbxNodeAttribute *data, std::string extension);
 namespace buffers
 {
-    char text[1024];
+    thread_local char text[1024];
 }
 
 struct MeshStatistics
@@ -49,11 +56,26 @@ struct MeshStatistics
         vertices += v.vertices;
         polygons += v.polygons;
         triangles += v.triangles;
-        edges += edges;
+        edges += v.edges;
         return *this;
     }
 };
 
+// scene content beyond geometry that an output mode reads
+enum ImportContent
+{
+    eImportGeometry = 0,
+    eImportLink = 1 << 0,
+    eImportShape = 1 << 1,
+    eImportMaterial = 1 << 2,
+    eImportTexture = 1 << 3,
+    eImportMedia = 1 << 4,
+    eImportAnimation = 1 << 5,
+    eImportAudio = 1 << 6,
+    eImportRig = 1 << 7,
+    eImportAll = 0xFF
+};
+
 struct FileOptions: public ArgumentOptions
 {
     bool skin;
@@ -61,72 +83,169 @@ struct FileOptions: public ArgumentOptions
     bool texture;
     bool check;
     bool obj;
+    bool full;
+    bool profile;
+    bool mapped;
+    int iobench = 0;
+    int threads = 0;
+    
+    FileOptions(std::string file): FileOptions(ArgumentOptions(file)) {}
     
-    FileOptions(std::string file): ArgumentOptions(file)
+    FileOptions(const ArgumentOptions &args): ArgumentOptions(args)
     {
+        std::string value;
+        if (get("threads", value)) { threads = atoi(value.c_str()); }
         obj = get("obj");
         mesh = get("mesh");
         skin = get("skin");
         texture = get("texture");
+        full = get("full");
+        profile = get("profile");
+        mapped = !(get("io", value) && value == "file") && streams::enabled();
+        if (get("iobench", value)) { iobench = std::max(1, atoi(value.c_str())); }
         if (get("debug")) { filter = ::debug; }
         if (get("error")) { filter = ::error; }
         check = get("check");
         if (check) { filter = ::check; }
     }
+    
+    int content()
+    {
+        // hierarchy dump lists every node attribute and animation stack
+        if (full || filter == ::debug) { return eImportAll; }
+        
+        int content = eImportGeometry;
+        if (skin) { content |= eImportLink; }
+        if (texture) { content |= eImportMaterial | eImportTexture | eImportMedia; }
+        return content;
+    }
+};
+
+template<typename T>
+struct LayerData
+{
+    bool valid = false;
+    char mapping = 0;
+    FbxLayerElement::EReferenceMode reference = FbxLayerElement::eDirect;
+    std::vector<T> directs;
+    std::vector<int> indices;
+    
+    void extract(FbxLayerElementTemplate<T> *element)
+    {
+        if (element == NULL) { return; }
+        valid = true;
+        mapping = element->GetMappingMode();
+        reference = element->GetReferenceMode();
+        
+        FbxLayerElementArrayTemplate<T> &data = element->GetDirectArray();
+        directs.reserve(data.GetCount());
+        for (auto i = 0; i < data.GetCount(); i++) { directs.push_back(data.GetAt(i)); }
+        
+        if (reference != FbxLayerElement::eDirect)
+        {
+            FbxLayerElementArrayTemplate<int> &indice = element->GetIndexArray();
+            indices.reserve(indice.GetCount());
+            for (auto i = 0; i < indice.GetCount(); i++) { indices.push_back(indice.GetAt(i)); }
+        }
+    }
+};
+
+struct BoneData
+{
+    FbxSkeleton *skeleton;
+    std::string mode;
+    std::string path;
+    FbxAMatrix node;
+    FbxAMatrix pose;
+    FbxAMatrix model;
+    bool associate;
+};
+    
+struct VertexWeight
+{
+    int32_t index;
+    double weight;
+    FbxSkeleton *skeleton;
+    
+    VertexWeight(int32_t i, double w, FbxSkeleton *s): index(i), weight(w), skeleton(s) {}
+    VertexWeight(): VertexWeight(-1, 0, NULL) {}
+};
+
+// plain copy of everything exporters need, so that encoding runs without touching the SDK scene
+struct MeshData
+{
+    std::string meshname;
+    std::string skinname;
+    std::string objname;
+    
+    double scale; // unit scale factor / 100, kept as the w of .mesh vertices
+    std::vector<FbxVector4> points; // in meters
+    std::vector<int> polygons;
+    std::vector<int> vertices;
+    
+    // layer 0, used by .mesh
+    LayerData<FbxVector4> normals;
+    LayerData<FbxVector4> tangents;
+    LayerData<FbxColor> colors;
+    LayerData<FbxVector2> uvs;
+    
+    // first geometry elements, used by .obj
+    LayerData<FbxVector4> elementNormals;
+    LayerData<FbxVector2> elementUVs;
+    
+    std::vector<BoneData> bones;
+    std::vector<std::vector<VertexWeight>> weights;
 };
 
 template<typename T>
-void encode(FbxLayerElementTemplate<T> *element, FileStream &fs)
+void encode(const LayerData<T> &element, FileStream &fs)
 {
-    FbxLayerElementArrayTemplate<T> &data = element->GetDirectArray();
+    auto &data = element.directs;
     fs.write<char>('d');
-    fs.write<char>(element->GetMappingMode());
-    fs.write<int>(data.GetCount());
+    fs.write<char>(element.mapping);
+    fs.write<int>((int)data.size());
     fs.alginp();
-    for (auto i = 0; i < data.GetCount(); i++)
+    for (auto i = 0; i < data.size(); i++)
     {
-        fs.write<T>(data.GetAt(i));
+        fs.write<T>(data[i]);
     }
     
-    auto flag = element->GetReferenceMode() == fbxsdk::FbxLayerElement::eIndexToDirect;
+    auto flag = element.reference == fbxsdk::FbxLayerElement::eIndexToDirect;
     fs.write<bool>(flag); // index mapping
     if (flag)
     {
-        FbxLayerElementArrayTemplate<int> &indice = element->GetIndexArray();
+        auto &indice = element.indices;
         fs.write('i');
-        fs.write<int>(indice.GetCount());
+        fs.write<int>((int)indice.size());
         fs.alginp();
-        for (auto i = 0; i < indice.GetCount(); i++)
+        for (auto i = 0; i < indice.size(); i++)
         {
-            fs.write<int>(indice.GetAt(i));
+            fs.write<int>(indice[i]);
         }
     }
 }
 
 #include <sys/stat.h>
 
-void exportOBJ(FbxMesh *mesh, FileOptions &fo)
+void exportOBJ(const MeshData &data)
 {
-    auto unit = mesh->GetScene()->GetGlobalSettings().GetSystemUnit();
-    
-    std::string filename = touch(fo, mesh, "obj");
-    FileStream fs(filename.c_str());
+    FileStream fs(data.objname.c_str());
     
     char line[1024];
-    for (auto i = 0; i < mesh->GetControlPointsCount(); i++)
+    for (auto i = 0; i < data.points.size(); i++)
     {
-        auto point = mesh->GetControlPointAt(i) * (unit.GetScaleFactor() / 100);
+        auto &point = data.points[i];
         auto size = sprintf(line, "v %.6f %.6f %.6f \n", point.mData[0], point.mData[1], point.mData[2]);
         fs.write(line, size);
     }
     
     std::function<int32_t(int32_t, int32_t)> normalMapping = nullptr;
-    auto normals = mesh->GetElementNormal();
-    if (normals != nullptr)
+    auto &normals = data.elementNormals;
+    if (normals.valid)
     {
-        auto &indices = normals->GetIndexArray();
-        auto &directs = normals->GetDirectArray();
-        if (normals->GetReferenceMode() == fbxsdk::FbxLayerElement::eDirect)
+        auto &indices = normals.indices;
+        auto &directs = normals.directs;
+        if (normals.reference == fbxsdk::FbxLayerElement::eDirect)
         {
             normalMapping = [&](int32_t pi, int32_t ci)->int32_t
             {
@@ -141,21 +260,21 @@ void exportOBJ(FbxMesh *mesh, FileOptions &fo)
             };
         }
         
-        for (auto i = 0; i < directs.GetCount(); i++)
+        for (auto i = 0; i < directs.size(); i++)
         {
-            auto n = directs.GetAt(i);
+            auto &n = directs[i];
             auto size = sprintf(line, "vn %.6f %.6f %.6f\n", n.mData[0], n.mData[1], n.mData[2]);
             fs.write(line, size);
         }
     }
     
     std::function<int32_t(int32_t, int32_t)> uvMapping = nullptr;
-    auto uvs = mesh->GetElementUV();
-    if (uvs != nullptr)
+    auto &uvs = data.elementUVs;
+    if (uvs.valid)
     {
-        auto &indices = uvs->GetIndexArray();
-        auto &directs = uvs->GetDirectArray();
-        if (uvs->GetReferenceMode() == fbxsdk::FbxLayerElement::eDirect)
+        auto &indices = uvs.indices;
+        auto &directs = uvs.directs;
+        if (uvs.reference == fbxsdk::FbxLayerElement::eDirect)
         {
             uvMapping = [&](int32_t pi, int32_t ci)->int32_t
             {
@@ -170,9 +289,9 @@ void exportOBJ(FbxMesh *mesh, FileOptions &fo)
             };
         }
         
-        for (auto i = 0; i < directs.GetCount(); i++)
+        for (auto i = 0; i < directs.size(); i++)
         {
-            auto n = directs.GetAt(i);
+            auto &n = directs[i];
             auto size = sprintf(line, "vt %.6f %.6f\n", n.mData[0], 1 - n.mData[1]);
             fs.write(line, size);
         }
@@ -181,20 +300,20 @@ void exportOBJ(FbxMesh *mesh, FileOptions &fo)
     char *ptr = nullptr;
     auto polygonVertexIndex = 0;
     auto controlVertexIndex = 0;
-    for (auto i = 0; i < mesh->GetPolygonCount(); i++)
+    for (auto i = 0; i < data.polygons.size(); i++)
     {
         ptr = line;
         ptr += sprintf(ptr, "f");
-        for (auto n = 0; n < mesh->GetPolygonSize(i); n++)
+        for (auto n = 0; n < data.polygons[i]; n++)
         {
-            controlVertexIndex = mesh->GetPolygonVertex(i, n);
+            controlVertexIndex = data.vertices[polygonVertexIndex];
             ptr += sprintf(ptr, " %d", controlVertexIndex + 1);
             if (uvMapping != nullptr)
             {
                 ptr += sprintf(ptr, "/%d", uvMapping(polygonVertexIndex, controlVertexIndex) + 1);
             }
             
-            if (normals != nullptr)
+            if (normals.valid)
             {
                 if (uvMapping == nullptr) { ptr += sprintf(ptr, "/"); }
                 ptr += sprintf(ptr, "/%d", normalMapping(polygonVertexIndex, controlVertexIndex) + 1);
@@ -217,16 +336,6 @@ std::string getLinkModeName(FbxCluster::ELinkMode mode)
     }
 }
     
-struct VertexWeight
-{
-    int32_t index;
-    double weight;
-    FbxSkeleton *skeleton;
-    
-    VertexWeight(int32_t i, double w, FbxSkeleton *s): index(i), weight(w), skeleton(s) {}
-    VertexWeight(): VertexWeight(-1, 0, NULL) {}
-};
-    
 FbxVector4 &fill(FbxVector4 &vector, double component)
 {
     auto ptr = vector.mData;
@@ -237,12 +346,16 @@ FbxVector4 &fill(FbxVector4 &vector, double component)
     return vector;
 }
     
-void encode(std::fstream &fs, FbxAMatrix matrix, FbxSystemUnit &unit, std::string indent)
+FbxAMatrix convert(FbxAMatrix matrix, const CoordinateConversion &conversion)
 {
+    conversion.matrices((double *)&matrix, 1);
+    return matrix;
+}
     
+void encode(std::fstream &fs, const FbxAMatrix &matrix, std::string indent)
+{
     char *ptr = buffers::text;
     ptr += sprintf(ptr, "%s: ", indent.c_str());
-    matrix.SetTRS(matrix.GetT() * (unit.GetScaleFactor() / 100), matrix.GetR(), matrix.GetS());
     
     auto &layout = matrix.Double44();
     for (auto i = 0; i < 4; i++)
@@ -257,12 +370,12 @@ void encode(std::fstream &fs, FbxAMatrix matrix, FbxSystemUnit &unit, std::strin
     fs.put('\n');
 }
     
-void exportSkin(FbxMesh *mesh, FileOptions &fo)
+void extractSkin(FbxMesh *mesh, MeshData &data)
 {
     auto scene = mesh->GetNode()->GetScene();
-    auto unit = scene->GetGlobalSettings().GetSystemUnit();
+    auto conversion = CoordinateConversion::units(scene->GetGlobalSettings().GetSystemUnit(), FbxSystemUnit::m);
     std::map<FbxSkeleton*, FbxCluster *> bones;
-    std::vector<std::vector<VertexWeight>> weights(mesh->GetControlPointsCount());
+    data.weights.resize(mesh->GetControlPointsCount());
     for (auto s = 0; s < mesh->GetDeformerCount(FbxDeformer::eSkin); s++)
     {
         auto skin = static_cast<FbxSkin *>(mesh->GetDeformer(s, FbxDeformer::eSkin));
@@ -277,51 +390,67 @@ void exportSkin(FbxMesh *mesh, FileOptions &fo)
             auto ptw = cluster->GetControlPointWeights();
             for (auto i = 0; i < cluster->GetControlPointIndicesCount(); i++)
             {
-                assert(*pti < weights.size());
-                auto &record = weights[*pti++];
+                assert(*pti < data.weights.size());
+                auto &record = data.weights[*pti++];
                 record.push_back(VertexWeight((int32_t)record.size(), *ptw++, skeleton));
             }
         }
     }
     
-    auto filename = touch(fo, mesh, "skin");
-    std::fstream fs(filename, std::fstream::out);
-    
-    char *ptr;
     for (auto iter = bones.begin(); iter != bones.end(); iter++)
     {
-        auto skeleton = iter->first;
+        BoneData bone;
+        bone.skeleton = iter->first;
         auto cluster = iter->second;
-        ptr = buffers::text;
-        auto size = sprintf(ptr, "%p ", skeleton);
-        fs.write(buffers::text, size);
-        auto mode = getLinkModeName(cluster->GetLinkMode());
-        fs.write(mode.c_str(), mode.size());
-        fs.put(' ');
+        bone.mode = getLinkModeName(cluster->GetLinkMode());
         
-        auto node = skeleton->GetNode();
+        auto node = bone.skeleton->GetNode();
         while (node != NULL)
         {
-            auto name = node->GetName();
-            fs.write(name, strlen(name));
+            bone.path += node->GetName();
             node = node->GetParent();
             if (!node->GetSkeleton()) {break;}
-            fs.put('/');
+            bone.path += '/';
         }
         
+        FbxAMatrix matrix;
+        bone.node = convert(cluster->GetTransformLinkMatrix(matrix), conversion);
+        bone.pose = convert(matrix.Inverse(), conversion);
+        bone.associate = cluster->GetAssociateModel() != NULL;
+        if (bone.associate)
+        {
+            bone.model = convert(cluster->GetTransformAssociateModelMatrix(matrix), conversion);
+        }
+        data.bones.push_back(bone);
+    }
+}
+    
+void exportSkin(MeshData &data)
+{
+    std::fstream fs(data.skinname, std::fstream::out);
+    
+    char *ptr;
+    for (auto iter = data.bones.begin(); iter != data.bones.end(); iter++)
+    {
+        auto &bone = *iter;
+        ptr = buffers::text;
+        auto size = sprintf(ptr, "%p ", bone.skeleton);
+        fs.write(buffers::text, size);
+        fs.write(bone.mode.c_str(), bone.mode.size());
+        fs.put(' ');
+        fs.write(bone.path.c_str(), bone.path.size());
         fs.put('\n');
         
-        FbxAMatrix matrix;
-        encode(fs, cluster->GetTransformLinkMatrix(matrix), unit, "  node");
-        encode(fs, matrix.Inverse(), unit, "  pose");
-        if (cluster->GetAssociateModel() != NULL)
+        encode(fs, bone.node, "  node");
+        encode(fs, bone.pose, "  pose");
+        if (bone.associate)
         {
-            encode(fs, cluster->GetTransformAssociateModelMatrix(matrix), unit, "  model");
+            encode(fs, bone.model, "  model");
         }
     }
     
     auto index = 0;
-    for (auto iter = weights.begin(); iter != weights.end(); iter++)
+    for (auto iter = data.weights.begin(); iter != data.weights.end(); iter++)
     {
         auto &record = *iter;
         std::sort(record.begin(), record.end(), [](VertexWeight a, VertexWeight b){return a.weight > b.weight;});
@@ -331,7 +460,7 @@ void exportSkin(FbxMesh *mesh, FileOptions &fo)
         {
             ptr += sprintf(ptr, "(%f,%p) ", w->weight, w->skeleton);
         }
-        auto vertex = mesh->GetControlPointAt(index) * (unit.GetScaleFactor() / 100);
+        auto &vertex = data.points[index];
         ptr += sprintf(ptr, "%f %f %f", vertex.mData[0], vertex.mData[1], vertex.mData[2]);
         fs.write(buffers::text, ptr - buffers::text);
         fs.put('\n');
@@ -355,29 +484,30 @@ std::string touch(FileOptions &fo, FbxNodeAttribute *data, std::string extension
     
 std::string createWorkspace(FileOptions &fo)
 {
-    auto pos = fo.filename.rfind('.');
-    std::string workspace = fo.filename.substr(0, pos) + ".fbm";
+    auto filename = archive::workpath(fo.filename);
+    auto pos = filename.rfind('.');
+    std::string workspace = filename.substr(0, pos) + ".fbm";
     mkdir(workspace.c_str(), 0777);
     return workspace;
 }
 
-void exportMesh(FbxMesh *mesh, FileOptions &fo)
+void exportMesh(const MeshData &data)
 {
-    auto unit = mesh->GetScene()->GetGlobalSettings().GetSystemUnit();
-    std::string filename = touch(fo, mesh, "mesh");
-    FileStream fs(filename.c_str());
+    FileStream fs(data.meshname.c_str());
     fs.write('M');
     fs.write('E');
     fs.write('S');
     fs.write('H');
     // vertices
     fs.write('V');
-    auto numControlVertices = mesh->GetControlPointsCount();
+    auto numControlVertices = (int)data.points.size();
     fs.write<int>(numControlVertices);
     fs.alginp();
     for (auto i = 0; i < numControlVertices; i++)
     {
-        fs.write<FbxVector4>(mesh->GetControlPointAt(i) * (unit.GetScaleFactor() / 100));
+        auto point = data.points[i];
+        point[3] *= data.scale;
+        fs.write<FbxVector4>(point);
     }
     
     // triangles
@@ -385,23 +515,22 @@ void exportMesh(FbxMesh *mesh, FileOptions &fo)
     auto offset = fs.tellg();
     fs.write<int>(0); // triangle count
     auto numTriangles = 0;
-    std::vector<int> polygonVertices;
+    auto numPolygonVertices = 0;
     fs.alginp();
-    for (auto i = 0; i < mesh->GetPolygonCount(); i++)
+    for (auto i = 0; i < data.polygons.size(); i++)
     {
-        auto size = mesh->GetPolygonSize(i);
-        auto anchor = polygonVertices.size();
+        auto size = data.polygons[i];
+        auto anchor = numPolygonVertices;
         for (auto t = 0; t < size; t++) // auto split polygons with more than 3 vertices
         {
-            auto vertex = mesh->GetPolygonVertex(i, t);
             if (t > 0 && t < size - 1)
             {
-                fs.write<int>((int)anchor);
-                fs.write<int>((int)polygonVertices.size());
-                fs.write<int>((int)polygonVertices.size() + 1);
+                fs.write<int>(anchor);
+                fs.write<int>(numPolygonVertices);
+                fs.write<int>(numPolygonVertices + 1);
                 numTriangles += 1;
             }
-            polygonVertices.push_back(vertex);
+            numPolygonVertices++;
         }
     }
     
@@ -413,42 +542,37 @@ void exportMesh(FbxMesh *mesh, FileOptions &fo)
     
     // encode polygon vertices
     fs.write<char>('P');
-    fs.write<int>((int)polygonVertices.size());
+    fs.write<int>((int)data.vertices.size());
     fs.alginp();
-    fs.write<int>(&polygonVertices.front(), (int)polygonVertices.size());
+    fs.write<int>(data.vertices.data(), (int)data.vertices.size());
     fs.write<char>('Z');
     
     // encode normals
-    auto layer = mesh->GetLayer(0);
-    auto normals = layer->GetNormals();
-    if (normals != NULL)
+    if (data.normals.valid)
     {
         fs.write<char>('n');
-        encode<FbxVector4>(normals, fs);
+        encode<FbxVector4>(data.normals, fs);
     }
     
     // encode tangents
-    auto tangents = layer->GetTangents();
-    if (tangents != NULL)
+    if (data.tangents.valid)
     {
         fs.write<char>('t');
-        encode<FbxVector4>(tangents, fs);
+        encode<FbxVector4>(data.tangents, fs);
     }
     
     // encode vertex colors
-    auto colors = layer->GetVertexColors();
-    if (colors != NULL)
+    if (data.colors.valid)
     {
         fs.write<char>('c');
-        encode<FbxColor>(colors, fs);
+        encode<FbxColor>(data.colors, fs);
     }
     
     // encode uvmapping
-    auto uvs = layer->GetUVs();
-    if (uvs != NULL)
+    if (data.uvs.valid)
     {
         fs.write<char>('u');
-        encode<FbxVector2>(uvs, fs);
+        encode<FbxVector2>(data.uvs, fs);
     }
 }
     
@@ -489,11 +613,11 @@ std::string describe(FbxLayerElementTemplate<T> *data)
 #define PRINT_MESH_ATTRIBUTE(FUNC_GET_COUNT, FUNC_GET_LAYOUT, NAME) \
 if ((count = FUNC_GET_COUNT))\
 {\
-    printf("%s \e[37m+%s\e[0m\n", indent.c_str(), NAME);\
+    output("%s \e[37m+%s\e[0m\n", indent.c_str(), NAME);\
     for (auto i = 0; i < count; i++)\
     {\
         auto data = FUNC_GET_LAYOUT;\
-        printf("%s   \e[32m-[%d] %s\e[0m\n", indent.c_str(), i, describe(data).c_str());\
+        output("%s   \e[32m-[%d] %s\e[0m\n", indent.c_str(), i, describe(data).c_str());\
     }\
 }
 
@@ -562,7 +686,7 @@ MeshStatistics dumpNodeHierarchy(FbxNode* node, FileOptions &fo, std::string ind
             default:break;
         }
         fo.print(debug, [&]{
-            printf("%s%s─\e[4m%s\e[0m \e[%dm%s\e[0m", indent.c_str(), closed ? "└" : "├", name.c_str(), isNull ? 96:33,  child->GetName());
+            output("%s%s─\e[4m%s\e[0m \e[%dm%s\e[0m", indent.c_str(), closed ? "└" : "├", name.c_str(), isNull ? 96:33,  child->GetName());
         });
 
         if (isMesh)
@@ -579,10 +703,10 @@ MeshStatistics dumpNodeHierarchy(FbxNode* node, FileOptions &fo, std::string ind
             stat.polygons += polygonCount;
             stat.triangles += triangleCount;
             fo.print(debug, [&]{
-                printf(" vertices=%d polygons=%d polygon_vertices=%d triangles=%d", mesh->GetControlPointsCount(), polygonCount, mesh->GetPolygonVertexCount(), triangleCount);
+                output(" vertices=%d polygons=%d polygon_vertices=%d triangles=%d", mesh->GetControlPointsCount(), polygonCount, mesh->GetPolygonVertexCount(), triangleCount);
             });
         }
-        fo.print(debug, [&]{printf("\n");});
+        fo.print(debug, [&]{output("\n");});
         if (isMesh)
         {
             auto mesh = static_cast<FbxMesh *>(attribute);
@@ -596,15 +720,71 @@ MeshStatistics dumpNodeHierarchy(FbxNode* node, FileOptions &fo, std::string ind
     return stat;
 }
     
-void process(FileOptions &fo, FbxMesh *mesh)
+void extract(FileOptions &fo, FbxMesh *mesh, MeshData &data)
+{
+    auto unit = mesh->GetScene()->GetGlobalSettings().GetSystemUnit();
+    data.scale = unit.GetScaleFactor() / 100;
+    
+    auto numControlVertices = mesh->GetControlPointsCount();
+    data.points.reserve(numControlVertices);
+    for (auto i = 0; i < numControlVertices; i++) { data.points.push_back(mesh->GetControlPointAt(i)); }
+    CoordinateConversion::units(unit, FbxSystemUnit::m).points((double *)data.points.data(), data.points.size(), 4);
+    
+    auto numPolygons = mesh->GetPolygonCount();
+    data.polygons.reserve(numPolygons);
+    data.vertices.reserve(mesh->GetPolygonVertexCount());
+    for (auto i = 0; i < numPolygons; i++)
+    {
+        auto size = mesh->GetPolygonSize(i);
+        data.polygons.push_back(size);
+        for (auto n = 0; n < size; n++) { data.vertices.push_back(mesh->GetPolygonVertex(i, n)); }
+    }
+    
+    if (fo.mesh)
+    {
+        data.meshname = touch(fo, mesh, "mesh");
+        produced(data.meshname);
+        auto layer = mesh->GetLayer(0);
+        if (layer != NULL)
+        {
+            data.normals.extract(layer->GetNormals());
+            data.tangents.extract(layer->GetTangents());
+            data.colors.extract(layer->GetVertexColors());
+            data.uvs.extract(layer->GetUVs());
+        }
+    }
+    
+    if (fo.skin)
+    {
+        data.skinname = touch(fo, mesh, "skin");
+        produced(data.skinname);
+        extractSkin(mesh, data);
+    }
+    
+    if (fo.obj)
+    {
+        data.objname = touch(fo, mesh, "obj");
+        produced(data.objname);
+        data.elementNormals.extract(mesh->GetElementNormal());
+        data.elementUVs.extract(mesh->GetElementUV());
+    }
+}
+    
+void process(FileOptions &fo, MeshData &data)
 {
-    if (fo.mesh) { exportMesh(mesh, fo); }
-    if (fo.skin) { exportSkin(mesh, fo); }
-    if (fo.obj) { exportOBJ(mesh, fo); }
+    if (fo.mesh) { exportMesh(data); }
+    if (fo.skin) { exportSkin(data); }
+    if (fo.obj) { exportOBJ(data); }
 }
 
 void process(FileOptions &fo, FbxScene *scene)
 {
+    if (!fo.mesh && !fo.skin && !fo.obj) { return; }
+    
+    // SDK reads stay on this thread, encoding of extracted meshes runs on the pool,
+    // at most twice as many meshes as workers are held in memory before extraction waits
+    Throttle throttle(fo.threads * 2);
+    WorkerPool<void> pool(fo.threads);
     for (auto i = 0; i < scene->GetSrcObjectCount(); i++)
     {
         auto obj = scene->GetSrcObject(i);
@@ -616,86 +796,180 @@ void process(FileOptions &fo, FbxScene *scene)
             switch (attribute->GetAttributeType())
             {
                 case FbxNodeAttribute::eMesh:
-                    process(fo, static_cast<FbxMesh *>(attribute));
+                {
+                    throttle.acquire();
+                    auto data = std::make_shared<MeshData>();
+                    extract(fo, static_cast<FbxMesh *>(attribute), *data);
+                    pool.submit([&fo, &throttle, data](void *)
+                    {
+                        process(fo, *data);
+                        throttle.release();
+                    });
                     break;
+                }
                     
                 default:break;
             }
         }
     }
+    pool.join();
+}
+
+// managers are reused across jobs so every flag is set for each import
+void configure(FbxIOSettings *settings, int content)
+{
+    settings->SetBoolProp(IMP_FBX_LINK, (content & eImportLink) != 0);
+    settings->SetBoolProp(IMP_FBX_SHAPE, (content & eImportShape) != 0);
+    settings->SetBoolProp(IMP_FBX_MATERIAL, (content & eImportMaterial) != 0);
+    settings->SetBoolProp(IMP_FBX_TEXTURE, (content & eImportTexture) != 0);
+    settings->SetBoolProp(IMP_FBX_EXTRACT_EMBEDDED_DATA, (content & eImportMedia) != 0);
+    settings->SetBoolProp(IMP_FBX_ANIMATION, (content & eImportAnimation) != 0);
+    settings->SetBoolProp(IMP_FBX_AUDIO, (content & eImportAudio) != 0);
+    settings->SetBoolProp(IMP_FBX_CHARACTER, (content & eImportRig) != 0);
+    settings->SetBoolProp(IMP_FBX_CONSTRAINT, (content & eImportRig) != 0);
+    settings->SetBoolProp(IMP_FBX_GOBO, (content & eImportRig) != 0);
+}
+
+// imports the file through the SDK's file reader and the mapped stream by turns and reports average time of each
+bool benchmark(FileOptions &fo, FbxManager *manager)
+{
+    configure(manager->GetIOSettings(), fo.content());
+    
+    double elapsed[2] = {0, 0};
+    for (auto n = 0; n <= fo.iobench; n++)
+    {
+        for (auto mapped = 0; mapped < 2; mapped++)
+        {
+            Stopwatch watch;
+            MappedFileStream stream;
+            auto importer = FbxImporter::Create(manager, "");
+            auto scene = FbxScene::Create(manager, "Scene");
+            auto success = initialize(importer, stream, fo.filename, manager->GetIOSettings(), mapped != 0) && importer->Import(scene);
+            importer->Destroy();
+            scene->Destroy();
+            if (!success)
+            {
+                output("[iobench] %s import failed\n", fo.filename.c_str());
+                return false;
+            }
+            
+            // first round only warms up page cache
+            if (n > 0) { elapsed[mapped] += watch.elapsed(); }
+        }
+    }
+    
+    output("[iobench] %s file=%.3fs mmap=%.3fs rounds=%d peak=%.1fMB\n", fo.filename.c_str(), elapsed[0] / fo.iobench, elapsed[1] / fo.iobench, fo.iobench, peakMemory());
+    return true;
 }
 
-bool process(FileOptions &fo, FbxManager *manager, MeshStatistics &statistics)
+bool process(FileOptions &fo, FbxManager *manager)
 {
-    auto importer = FbxImporter::Create(manager, "");
-    if (!importer->Initialize(fo.filename.c_str(), -1, manager->GetIOSettings()))
+    if (fo.iobench > 0) { return benchmark(fo, manager); }
+    
+    Stopwatch watch;
+    configure(manager->GetIOSettings(), fo.content());
+    
+    MappedFileStream stream;
+    FbxAutoDestroyPtr<FbxImporter> importer(FbxImporter::Create(manager, ""));
+    if (!initialize(importer, stream, fo.filename, manager->GetIOSettings(), fo.mapped))
     {
         fo.print(error, [&]{
-            printf("Call to FbxImporter::Intialize() failed.\n");
-            printf("Error returned: %s \n", importer->GetStatus().GetErrorString());
+            output("Call to FbxImporter::Intialize() failed.\n");
+            output("Error returned: %s \n", importer->GetStatus().GetErrorString());
         });
         return false;
     }
     
-    auto scene = FbxScene::Create(manager, "Scene");
+    FbxAutoDestroyPtr<FbxScene> scene(FbxScene::Create(manager, "Scene"));
     
     if (!importer->Import(scene))
     {
         fo.print(error, [&]{
-            printf("%s\n", importer->GetStatus().GetErrorString());
+            output("%s\n", importer->GetStatus().GetErrorString());
         });
         return false;
     }
     
-    importer->Destroy();
+    importer.Reset();
+    
+    if (fo.profile)
+    {
+        output("[profile] %s import=%.3fs peak=%.1fMB content=0x%02X\n", fo.filename.c_str(), watch.elapsed(), peakMemory(), fo.content());
+    }
     
     auto numStacks = scene->GetSrcObjectCount<FbxAnimStack>();
     for (auto i = 0; i < numStacks; i++)
     {
         auto pAnimStack = scene->GetSrcObject<FbxAnimStack>(i);
         fo.print(debug, [&]{
-            printf("[Animation][%d/%d] %s\n", i + 1, numStacks, pAnimStack->GetName());
+            output("[Animation][%d/%d] %s\n", i + 1, numStacks, pAnimStack->GetName());
         });
     }
     auto unit = FbxSystemUnit::cm;
     auto stat = dumpNodeHierarchy(scene->GetRootNode(), fo);
     fo.print(debug, [&]{
-        printf("# vertices=%d polygons=%d triangles=%d\n", stat.vertices, stat.polygons, stat.triangles);
+        output("# vertices=%d polygons=%d triangles=%d\n", stat.vertices, stat.polygons, stat.triangles);
     });
     
     fo.print(check, [&]{
-        printf("%s %d %d %d\n", fo.filename.c_str(), stat.vertices, stat.polygons, stat.triangles);
+        output("%s %d %d %d\n", fo.filename.c_str(), stat.vertices, stat.polygons, stat.triangles);
     });
     
-    statistics += stat;
-    process(fo, scene);
-    scene->Destroy();
+    tally("vertices", stat.vertices);
+    tally("polygons", stat.polygons);
+    tally("triangles", stat.triangles);
+    process(fo, scene.Get());
     
     return true;
 }
 
 int main(int argc, const char * argv[])
 {
-    if (argc <= 1) {return 1;}
+    CommandOptions options(argc, argv);
+    memory::install();
     
-    FbxManager* pManager = FbxManager::Create();
-    pManager->SetIOSettings(FbxIOSettings::Create(pManager, IOSROOT));
+    auto count = static_cast<int>(options.files.size());
+    std::vector<MeshStatistics> stats(count);
     
-    MeshStatistics statistics;
-    for (auto i = 1; i < argc; i++)
+    ToolDriver<FbxManager> tool;
+    tool.name = "fbxdump";
+    tool.version = FBXTOOLS_VERSION " " FBXSDK_VERSION_STRING;
+    tool.create = []
     {
-        FileOptions fo(argv[i]);
-        fo.print(debug, [&]{printf("[%d/%d] %s\n", i, argc - 1, argv[i]);});
-        process(fo, pManager, statistics);
-        fo.print(debug, [&]{printf("\n");});
-    }
+        FbxManager* pManager = FbxManager::Create();
+        pManager->SetIOSettings(FbxIOSettings::Create(pManager, IOSROOT));
+        return pManager;
+    };
+    tool.destroy = [](FbxManager *pManager)
+    {
+        pManager->Destroy();
+    };
+    tool.announce = [](ArgumentOptions &args, int i, int count)
+    {
+        FileOptions fo(args);
+        fo.print(debug, [&]{output("[%d/%d] %s\n", i + 1, count, fo.filename.c_str());});
+    };
+    tool.process = [&](FbxManager *pManager, ArgumentOptions &args)
+    {
+        FileOptions fo(args);
+        if (fo.threads <= 0) { fo.threads = std::max(1, (int)std::thread::hardware_concurrency() / options.jobs); }
+        auto success = process(fo, pManager);
+        fo.print(debug, [&]{output("\n");});
+        return success;
+    };
+    tool.finished = [&](int i, ArgumentOptions &args, JobRecord &record)
+    {
+        auto &counters = record.counters;
+        stats[i] = MeshStatistics((int)counters["vertices"], (int)counters["polygons"], (int)counters["triangles"], 0);
+    };
     
-    if (argc > 2)
+    auto result = drive(tool, options);
+    if (options.serve.empty() && count > 1)
     {
+        MeshStatistics statistics;
+        for (auto iter = stats.begin(); iter != stats.end(); iter++) { statistics += *iter; }
         printf("[] vertices=%d polygons=%d triangles=%d\n", statistics.vertices, statistics.polygons, statistics.triangles);
     }
     
-    pManager->Destroy();
-    
-    return 0;
+    return result;
 }
@@ -9,9 +9,21 @@
 #include <iostream>
 #include <fstream>
 #include <serialize.h>
+#include <arguments.h>
+#include <workers.h>
+#include <cache.h>
+#include <streams.h>
+#include <driver.h>
+#include <fbxbinary.h>
+#include <conversion.h>
+#include <profile.h>
 #include <vector>
 #include <map>
+#include <memory>
+#include <chrono>
 #include <math.h>
+#include <fnmatch.h>
+#include <sys/stat.h>
 
 struct BoneInfluence
 {
@@ -32,58 +44,237 @@ FbxVector4 rotate(FbxVector4 v, float angle, int axis = 0)
     return r;
 }
 
-void rotate(double *v, float angle, int axis = 0)
+// database meshes are z up and left handed with the camera on -y
+const CoordinateConversion &skinnedConversion()
 {
-    auto x = (axis + 1) % 3;
-    auto y = (axis + 2) % 3;
-    if (x > y) { auto t = x; x = y; y = t; }
+    static auto conversion = CoordinateConversion::between(FbxAxisSystem(FbxAxisSystem::eZAxis, (FbxAxisSystem::EFrontVector)-FbxAxisSystem::eParityOdd, FbxAxisSystem::eLeftHanded), FbxAxisSystem(FbxAxisSystem::eOpenGL));
+    return conversion;
+}
+
+// influences grouped by bone in three flat passes: count per bone, prefix sum, scatter in vertex order,
+// zero weights and out of range bones are left out, a bone repeated on one vertex keeps its last weight
+class ClusterWeights
+{
+    std::vector<int> __offsets; // numBones + 1
+    std::vector<int> __vertices;
+    std::vector<double> __weights;
     
-    auto radian = M_PI * angle / 180;
-    auto tx = std::cos(radian) * v[x] - std::sin(radian) * v[y];
-    auto ty = std::sin(radian) * v[x] + std::cos(radian) * v[y];
-    v[x] = tx;
-    v[y] = ty;
+public:
+    ClusterWeights(const std::vector<BoneInfluence> &influences, size_t numBones): __offsets(numBones + 1, 0)
+    {
+        auto used = [&](const BoneInfluence &influence, int i)
+        {
+            auto index = influence.indices[i];
+            if (influence.weights[i] == 0 || index >= numBones) { return false; }
+            for (auto n = i + 1; n < 4; n++)
+            {
+                if (influence.indices[n] == index && influence.weights[n] != 0) { return false; }
+            }
+            return true;
+        };
+        
+        for (auto iter = influences.begin(); iter != influences.end(); iter++)
+        {
+            for (auto i = 0; i < 4; i++) { if (used(*iter, i)) { __offsets[iter->indices[i] + 1]++; } }
+        }
+        for (size_t i = 0; i < numBones; i++) { __offsets[i + 1] += __offsets[i]; }
+        
+        __vertices.resize(__offsets[numBones]);
+        __weights.resize(__offsets[numBones]);
+        std::vector<int> cursors(__offsets.begin(), __offsets.end() - 1);
+        auto vertex = 0;
+        for (auto iter = influences.begin(); iter != influences.end(); iter++, vertex++)
+        {
+            for (auto i = 0; i < 4; i++)
+            {
+                if (!used(*iter, i)) { continue; }
+                auto &cursor = cursors[iter->indices[i]];
+                __vertices[cursor] = vertex;
+                __weights[cursor] = iter->weights[i];
+                cursor++;
+            }
+        }
+    }
+    
+    size_t size() const { return __offsets.size() - 1; }
+    int count(int bone) const { return __offsets[bone + 1] - __offsets[bone]; }
+    const int *vertices(int bone) const { return __vertices.data() + __offsets[bone]; }
+    const double *weights(int bone) const { return __weights.data() + __offsets[bone]; }
+};
+
+// one mesh record of the database
+struct MeshAsset
+{
+    std::string name;
+    float aabb[6];
+    std::vector<FbxAMatrix> poses;
+    std::vector<BoneInfluence> influences;
+    
+    std::vector<FbxVector3> vertices;
+    std::vector<uint32_t> triangles;
+    std::vector<FbxVector4> tangents;
+    std::vector<FbxVector3> normals;
+    std::vector<FbxVector2> uvs;
+    
+    Skeleton skeleton;
+};
+
+void read_mesh(FileStream &fs, MeshAsset &asset)
+{
+    asset.name = fs.read<std::string>();
+    
+    fs.read(&asset.aabb[0], 6);
+    asset.poses = fs.read_vector<FbxAMatrix>();
+    asset.influences = fs.read_vector<BoneInfluence>();
+    
+    asset.vertices = fs.read_vector<FbxVector3>();
+    asset.triangles = fs.read_vector<uint32_t>();
+    asset.tangents = fs.read_vector<FbxVector4>();
+    asset.normals = fs.read_vector<FbxVector3>();
+    asset.uvs = fs.read_vector<FbxVector2>();
+    
+    asset.skeleton = fs.read<Skeleton>();
+    
+    // skinned meshes come in the space of their bones
+    if (asset.skeleton.nodes.size())
+    {
+        auto &conversion = skinnedConversion();
+        conversion.tangents((double *)asset.tangents.data(), asset.tangents.size(), 4);
+        conversion.points((double *)asset.vertices.data(), asset.vertices.size(), 3);
+        conversion.directions((double *)asset.normals.data(), asset.normals.size(), 3);
+    }
 }
 
-void convert(double *v)
+template<typename T, typename S>
+void fill(FbxLayerElementArrayTemplate<T> &array, const std::vector<S> &data, bool bulk)
 {
-    rotate(v, -90, 0);
-    v[0] = -v[0];
+    auto count = static_cast<int>(data.size());
+    if (bulk)
+    {
+        array.Resize(count);
+        auto ptr = array.GetCount() == count ? array.GetLocked((T *)nullptr, FbxLayerElementArray::eWriteLock) : nullptr;
+        if (ptr != nullptr)
+        {
+            for (auto i = 0; i < count; i++) { ptr[i] = data[i]; }
+            array.Release(&ptr, (T *)nullptr);
+            return;
+        }
+        array.Clear();
+    }
+    
+    for (auto iter = data.begin(); iter != data.end(); iter++) { array.Add(*iter); }
 }
 
-void generate_meshfbx(FileStream &fs)
+template<typename T>
+bool same_elements(const FbxLayerElementTemplate<T> *a, const FbxLayerElementTemplate<T> *b)
 {
-    FbxManager* manager = FbxManager::Create();
-    manager->SetIOSettings(FbxIOSettings::Create(manager, IOSROOT));
+    if (a == nullptr || b == nullptr) { return a == b; }
+    if (a->GetMappingMode() != b->GetMappingMode() || a->GetReferenceMode() != b->GetReferenceMode()) { return false; }
     
-    auto name = fs.read<std::string>();
+    auto &x = a->GetDirectArray();
+    auto &y = b->GetDirectArray();
+    if (x.GetCount() != y.GetCount()) { return false; }
+    for (auto i = 0; i < x.GetCount(); i++)
+    {
+        if (!(x.GetAt(i) == y.GetAt(i))) { return false; }
+    }
+    return true;
+}
+
+bool same_mesh(FbxMesh *a, FbxMesh *b)
+{
+    auto count = a->GetControlPointsCount();
+    if (count != b->GetControlPointsCount() || a->GetPolygonCount() != b->GetPolygonCount()) { return false; }
+    if (memcmp(a->GetControlPoints(), b->GetControlPoints(), sizeof(FbxVector4) * count) != 0) { return false; }
     
-    float aabb[6];
-    fs.read(&aabb[0], 6);
-    auto poses = fs.read_vector<FbxAMatrix>();
-    auto influences = fs.read_vector<BoneInfluence>();
+    for (auto i = 0; i < a->GetPolygonCount(); i++)
+    {
+        if (a->GetPolygonVertexIndex(i) != b->GetPolygonVertexIndex(i) || a->GetPolygonSize(i) != b->GetPolygonSize(i)) { return false; }
+        if (a->GetPolygonGroup(i) != b->GetPolygonGroup(i)) { return false; }
+    }
     
-    auto vertices = fs.read_vector<FbxVector3>();
-    auto triangles = fs.read_vector<uint32_t>();
-    auto tangents = fs.read_vector<FbxVector4>();
-    auto normals = fs.read_vector<FbxVector3>();
-    auto uvs = fs.read_vector<FbxVector2>();
+    auto vertices = a->GetPolygonVertexCount();
+    if (vertices != b->GetPolygonVertexCount()) { return false; }
+    if (vertices > 0 && memcmp(a->GetPolygonVertices(), b->GetPolygonVertices(), sizeof(int) * vertices) != 0) { return false; }
     
-    auto skeleton = fs.read<Skeleton>();
+    auto x = a->GetLayer(0);
+    auto y = b->GetLayer(0);
+    return same_elements(x->GetNormals(), y->GetNormals()) && same_elements(x->GetUVs(), y->GetUVs()) && same_elements(x->GetTangents(), y->GetTangents());
+}
+
+// control points, triangles and layer 0 elements, bulk sizes the SDK arrays once and fills them in place
+// instead of one SetControlPointAt() and one Add() per element, polygons are not bulk built: FbxMesh has no
+// supported call taking them at once and its polygon arrays must only change through BeginPolygon/AddPolygon/EndPolygon,
+// so both paths add them one by one and bulk only reserves their storage, tests/fbxgen_mesh_test.cpp checks both paths
+void build_mesh(FbxMesh *mesh, FbxLayer *layer, const MeshAsset &asset, bool bulk)
+{
+    auto &vertices = asset.vertices;
+    auto &triangles = asset.triangles;
     
-    auto scene = FbxScene::Create(manager, "Scene");
+    // vertices
+    mesh->InitControlPoints(static_cast<int>(vertices.size()));
+    if (bulk)
     {
-        const FbxSystemUnit::ConversionOptions options = {
-            true, /* mConvertRrsNodes */
-            true, /* mConvertLimits */
-            true, /* mConvertClusters */
-            true, /* mConvertLightIntensity */
-            true, /* mConvertPhotometricLProperties */
-            true  /* mConvertCameraClipPlanes */
-        };
-        FbxSystemUnit::m.ConvertScene(scene, options);
+        auto points = mesh->GetControlPoints();
+        for (auto i = 0; i < vertices.size(); i++) { points[i] = vertices[i]; }
+        mesh->ReservePolygonCount(static_cast<int>(triangles.size() / 3));
+        mesh->ReservePolygonVertexCount(static_cast<int>(triangles.size() / 3 * 3));
+    }
+    else
+    {
+        for (auto i = 0; i < vertices.size(); i++) { mesh->SetControlPointAt(vertices[i], i); }
     }
     
+    for (auto iter = triangles.begin(); iter + 2 < triangles.end();)
+    {
+        mesh->BeginPolygon();
+        mesh->AddPolygon(*iter++);
+        mesh->AddPolygon(*iter++);
+        mesh->AddPolygon(*iter++);
+        mesh->EndPolygon();
+    }
+    
+    { // normals
+        auto element = FbxLayerElementNormal::Create(mesh, "Normals");
+        element->SetMappingMode(FbxLayerElement::eByControlPoint);
+        element->SetReferenceMode(FbxLayerElement::eDirect);
+        fill(element->GetDirectArray(), asset.normals, bulk);
+        layer->SetNormals(element);
+    }
+    
+    { // uvs
+        auto element = FbxLayerElementUV::Create(mesh, "UVs");
+        element->SetMappingMode(FbxLayerElement::eByControlPoint);
+        element->SetReferenceMode(FbxLayerElement::eDirect);
+        fill(element->GetDirectArray(), asset.uvs, bulk);
+        layer->SetUVs(element);
+    }
+    
+    { // tangents
+        auto element = FbxLayerElementTangent::Create(mesh, "Tangents");
+        element->SetMappingMode(FbxLayerElement::eByControlPoint);
+        element->SetReferenceMode(FbxLayerElement::eDirect);
+        fill(element->GetDirectArray(), asset.tangents, bulk);
+        layer->SetTangents(element);
+    }
+}
+
+// sized once and filled in place, AddControlPointIndex() would append behind the presized entries
+void fill(FbxCluster *cluster, const ClusterWeights &weights, int bone)
+{
+    auto count = weights.count(bone);
+    cluster->SetControlPointIWCount(count);
+    if (count == 0) { return; }
+    memcpy(cluster->GetControlPointIndices(), weights.vertices(bone), count * sizeof(int));
+    memcpy(cluster->GetControlPointWeights(), weights.weights(bone), count * sizeof(double));
+}
+
+// a mesh node with its own material, layers and, against the bones given, its own skin
+void generate_meshnode(FbxScene *scene, const MeshAsset &asset, const std::vector<FbxNode *> &bones, FbxSurfaceMaterial *material, bool verify)
+{
+    auto &name = asset.name;
+    auto &skeleton = asset.skeleton;
+    
     auto meshNode = FbxNode::Create(scene, name.c_str());
     scene->GetRootNode()->AddChild(meshNode);
     scene->ConnectSrcObject(meshNode);
@@ -93,22 +284,82 @@ void generate_meshfbx(FileStream &fs)
     
     if (skeleton.nodes.size())
     {
-        std::vector<std::map<uint16_t, float>> weights;
-        weights.resize(poses.size());
+        ClusterWeights weights(asset.influences, asset.poses.size());
         
-        auto vertex = 0;
-        for (auto iter = influences.begin(); iter != influences.end(); iter++)
+        auto skin = FbxSkin::Create(scene, "Skin");
+        for (auto i = 0; i < skeleton.bones.size(); i++)
         {
-            for (auto i = 0; i < 4; i++)
-            {
-                auto index = iter->indices[i];
-                auto &cluster = weights[index];
-                cluster[vertex] = iter->weights[i];
-            }
-            vertex++;
+            if (i >= weights.size()) {continue;}
+            
+            auto index = skeleton.bones[i];
+            auto &name = skeleton.names[index];
+            auto &bone = bones[index];
+            
+            auto cluster = FbxCluster::Create(scene, name.c_str());
+            cluster->SetLink(bone);
+            cluster->SetLinkMode(FbxCluster::eNormalize);
+            cluster->SetTransformLinkMatrix(bone->EvaluateGlobalTransform());
+            
+            fill(cluster, weights, i);
+            
+            skin->AddCluster(cluster);
         }
         
-        std::vector<FbxNode*> bones;
+        mesh->AddDeformer(skin);
+    }
+    
+    auto layer = mesh->GetLayer(0);
+    if (!layer)
+    {
+        mesh->CreateLayer();
+        layer = mesh->GetLayer(0);
+    }
+    
+    meshNode->AddMaterial(material);
+    
+    auto start = std::chrono::steady_clock::now();
+    build_mesh(mesh, layer, asset, true);
+    
+    if (verify)
+    { // same mesh through per element calls in a scratch scene, polygons are added the same way by both
+        auto elapsed = std::chrono::steady_clock::now() - start;
+        auto scratch = FbxScene::Create(scene->GetFbxManager(), "Verify");
+        auto reference = FbxMesh::Create(scratch, name.c_str());
+        reference->CreateLayer();
+        
+        start = std::chrono::steady_clock::now();
+        build_mesh(reference, reference->GetLayer(0), asset, false);
+        auto baseline = std::chrono::steady_clock::now() - start;
+        
+        auto ms = [](std::chrono::steady_clock::duration d) { return std::chrono::duration<double, std::milli>(d).count(); };
+        auto same = same_mesh(mesh, reference);
+        output("%s %s bulk=%.2fms polygons=%.2fms\n", same ? "==" : "[E] !=", name.c_str(), ms(elapsed), ms(baseline));
+        scratch->Destroy(true);
+    }
+}
+
+// one scene of the meshes given, which all share the skeleton of the first one, built once
+// ?verify builds every mesh through both paths and compares them
+bool generate_meshfbx(const std::vector<MeshAsset> &meshes, const std::string &savename, FbxManager *manager, const ExportOptions &options, bool verify = false)
+{
+    auto &skeleton = meshes.front().skeleton;
+    
+    auto scene = FbxScene::Create(manager, "Scene");
+    {
+        const FbxSystemUnit::ConversionOptions options = {
+            true, /* mConvertRrsNodes */
+            true, /* mConvertLimits */
+            true, /* mConvertClusters */
+            true, /* mConvertLightIntensity */
+            true, /* mConvertPhotometricLProperties */
+            true  /* mConvertCameraClipPlanes */
+        };
+        FbxSystemUnit::m.ConvertScene(scene, options);
+    }
+    
+    std::vector<FbxNode*> bones;
+    if (skeleton.nodes.size())
+    {
         for (auto i = 0; i < skeleton.poses.size(); i++)
         {
             auto &name = skeleton.names[i];
@@ -119,10 +370,6 @@ void generate_meshfbx(FileStream &fs)
             bones.push_back(node);
         }
         
-        for (auto iter = tangents.begin(); iter != tangents.end(); iter++) { convert((double *)&*iter); }
-        for (auto iter = vertices.begin(); iter != vertices.end(); iter++) { convert((double *)&*iter); }
-        for (auto iter = normals.begin(); iter != normals.end(); iter++) { convert((double *)&*iter); }
-        
         for (auto i = 0; i < bones.size(); i++)
         {
             auto node = bones[i];
@@ -135,136 +382,900 @@ void generate_meshfbx(FileStream &fs)
             node->LclRotation.Set(mat.GetR());
             node->LclScaling.Set(mat.GetS());
         }
+    }
+    
+    auto material = FbxSurfaceLambert::Create(scene, "Lambert");
+    material->ShadingModel.Set("Lambert");
+    material->Emissive.Set(FbxDouble3(0, 0, 0));
+    material->Ambient.Set(FbxDouble3(1, 1, 1));
+    material->Diffuse.Set(FbxDouble3(1, 1, 1));
+    material->TransparencyFactor.Set(0);
+    
+    for (auto iter = meshes.begin(); iter != meshes.end(); iter++) { generate_meshnode(scene, *iter, bones, material, verify); }
+    
+    if (bones.size())
+    { // bind pose of the shared skeleton, the clusters of every mesh link against it
+        auto pose = FbxPose::Create(scene, "BindPose");
+        pose->SetIsBindPose(true);
+        for (auto iter = bones.begin(); iter != bones.end(); iter++) { pose->Add(*iter, FbxMatrix((*iter)->EvaluateGlobalTransform())); }
+        scene->AddPose(pose);
+    }
+    
+    std::string error;
+    BufferedFileStream target;
+    auto exporter = FbxExporter::Create(manager, "");
+    auto success = initialize(exporter, target, savename, manager->GetIOSettings(), options) && exporter->Export(scene);
+    if (!success)
+    {
+        error = exporter->GetStatus().GetErrorString();
+        output("[E] %s %s\n", savename.c_str(), error.c_str());
+    }
+    else
+    {
+        produced(savename);
+        output(">> %s\n", savename.c_str());
+    }
+    
+    exporter->Destroy();
+    scene->Destroy(true);
+    return success;
+}
+
+namespace fbxwrite
+{
+    // constants the SDK accepts together, as written by other native FBX exporters
+    const char fileId[] = "\x28\xb3\x2a\xeb\xb6\x24\xcc\xc2\xbf\xc8\xb0\x2a\xa9\x2b\xfc\xf1";
+    const char footerId[] = "\xfa\xbc\xab\x09\xd0\xc8\xd4\x66\xb1\x76\xfb\x83\x1c\xf7\x26\x7e";
+    const char creationTime[] = "1970-01-01 10:00:00:000";
+    
+    std::string name(const std::string &name, const char *type)
+    {
+        return name + std::string("\0\x01", 2) + type;
+    }
+    
+    // P: name, type, label, flags, values... of Properties70
+    template<typename ...Values>
+    void P(BinaryRecordWriter &w, const char *name, const char *type, const char *label, const char *flags, Values... values)
+    {
+        w.begin("P");
+        w.add(name);
+        w.add(type);
+        w.add(label);
+        w.add(flags);
+        int expand[] = {0, (w.add(values), 0)...};
+        (void)expand;
+        w.end();
+    }
+    
+    void P(BinaryRecordWriter &w, const char *name, const FbxDouble3 &v)
+    {
+        P(w, name, name, "", "A", v.mData[0], v.mData[1], v.mData[2]);
+    }
+    
+    void header(BinaryRecordWriter &w)
+    {
+        auto t = time(nullptr);
+        struct tm now;
+        localtime_r(&t, &now);
         
-        auto skin = FbxSkin::Create(scene, "Skin");
-        for (auto i = 0; i < skeleton.bones.size(); i++)
+        w.header();
+        w.begin("FBXHeaderExtension");
+        w.record("FBXHeaderVersion", (int32_t)1003);
+        w.record("FBXVersion", (int32_t)w.version());
+        w.record("EncryptionType", (int32_t)0);
+        w.begin("CreationTimeStamp");
+        w.record("Version", (int32_t)1000);
+        w.record("Year", (int32_t)now.tm_year + 1900);
+        w.record("Month", (int32_t)now.tm_mon + 1);
+        w.record("Day", (int32_t)now.tm_mday);
+        w.record("Hour", (int32_t)now.tm_hour);
+        w.record("Minute", (int32_t)now.tm_min);
+        w.record("Second", (int32_t)now.tm_sec);
+        w.record("Millisecond", (int32_t)0);
+        w.end();
+        w.record("Creator", "fbxgen " FBXTOOLS_VERSION);
+        w.end();
+        
+        w.begin("FileId");
+        w.raw(fileId, 16);
+        w.end();
+        w.record("CreationTime", creationTime);
+        w.record("Creator", "fbxgen " FBXTOOLS_VERSION);
+        
+        // Y up, right handed, meters as FbxSystemUnit::m.ConvertScene() leaves an empty scene
+        w.begin("GlobalSettings");
+        w.record("Version", (int32_t)1000);
+        w.begin("Properties70");
+        P(w, "UpAxis", "int", "Integer", "", (int32_t)1);
+        P(w, "UpAxisSign", "int", "Integer", "", (int32_t)1);
+        P(w, "FrontAxis", "int", "Integer", "", (int32_t)2);
+        P(w, "FrontAxisSign", "int", "Integer", "", (int32_t)1);
+        P(w, "CoordAxis", "int", "Integer", "", (int32_t)0);
+        P(w, "CoordAxisSign", "int", "Integer", "", (int32_t)1);
+        P(w, "OriginalUpAxis", "int", "Integer", "", (int32_t)-1);
+        P(w, "OriginalUpAxisSign", "int", "Integer", "", (int32_t)1);
+        P(w, "UnitScaleFactor", "double", "Number", "", 100.0);
+        P(w, "OriginalUnitScaleFactor", "double", "Number", "", 100.0);
+        P(w, "AmbientColor", "ColorRGB", "Color", "", 0.0, 0.0, 0.0);
+        P(w, "DefaultCamera", "KString", "", "", "Producer Perspective");
+        P(w, "TimeMode", "enum", "", "", (int32_t)11);
+        P(w, "TimeSpanStart", "KTime", "Time", "", (int64_t)0);
+        P(w, "TimeSpanStop", "KTime", "Time", "", (int64_t)46186158000);
+        P(w, "CustomFrameRate", "double", "Number", "", -1.0);
+        w.end();
+        w.end();
+        
+        w.begin("Documents");
+        w.record("Count", (int32_t)1);
+        w.begin("Document");
+        w.add((int64_t)1000000);
+        w.add("Scene");
+        w.add("Scene");
+        w.begin("Properties70");
+        P(w, "SourceObject", "object", "", "");
+        P(w, "ActiveAnimStackName", "KString", "", "", "");
+        w.end();
+        w.record("RootNode", (int64_t)0);
+        w.end();
+        w.end();
+        
+        w.begin("References");
+        w.end();
+    }
+    
+    void definitions(BinaryRecordWriter &w, const std::vector<std::pair<const char *, int32_t>> &types)
+    {
+        auto total = 1;
+        for (auto iter = types.begin(); iter != types.end(); iter++) { total += iter->second; }
+        
+        w.begin("Definitions");
+        w.record("Version", (int32_t)100);
+        w.record("Count", (int32_t)total);
+        w.begin("ObjectType");
+        w.add("GlobalSettings");
+        w.record("Count", (int32_t)1);
+        w.end();
+        for (auto iter = types.begin(); iter != types.end(); iter++)
         {
-            if (i >= weights.size()) {continue;}
-            
-            auto index = skeleton.bones[i];
-            auto &name = skeleton.names[index];
-            auto &bone = bones[index];
+            if (iter->second == 0) { continue; }
+            w.begin("ObjectType");
+            w.add(iter->first);
+            w.record("Count", iter->second);
+            w.end();
+        }
+        w.end();
+    }
+    
+    void model(BinaryRecordWriter &w, int64_t id, const std::string &name, const char *type)
+    {
+        w.begin("Model");
+        w.add(id);
+        w.add(fbxwrite::name(name, "Model"));
+        w.add(type);
+        w.record("Version", (int32_t)232);
+    }
+    
+    void connect(BinaryRecordWriter &w, int64_t child, int64_t parent)
+    {
+        w.begin("C");
+        w.add("OO");
+        w.add(child);
+        w.add(parent);
+        w.end();
+    }
+    
+    void layer(BinaryRecordWriter &w, const char *type, int32_t version, const char *name, const char *mapping, const char *reference)
+    {
+        w.begin(type);
+        w.add((int32_t)0);
+        w.record("Version", version);
+        w.record("Name", name);
+        w.record("MappingInformationType", mapping);
+        w.record("ReferenceInformationType", reference);
+    }
+}
+
+// same scene as generate_meshfbx() written straight into binary FBX records, 7.4 unless ?fbxversion asks otherwise, no SDK scene involved
+// arrays stay uncompressed without ?compresslevel, shorter ones than ?compressmin bytes always do
+bool write_meshfbx(const std::vector<MeshAsset> &meshes, const std::string &savename, const ExportOptions &options)
+{
+    using namespace fbxwrite;
+    
+    auto &skeleton = meshes.front().skeleton;
+    auto skinned = skeleton.nodes.size() > 0;
+    auto numBones = skinned ? (int)skeleton.poses.size() : 0;
+    auto numMeshes = (int)meshes.size();
+    
+    // ids: 1 material, 2 bind pose, bone models and attributes, then mesh model, geometry, skin and clusters of each mesh
+    const int64_t base = 1000000;
+    const int64_t materialId = base + 1;
+    const int64_t poseId = base + 2;
+    auto boneId = [&](int i) { return base + 10 + 2 * (int64_t)i; };
+    auto attributeId = [&](int i) { return boneId(i) + 1; };
+    std::vector<int64_t> meshIds;
+    for (auto iter = meshes.begin(); iter != meshes.end(); iter++)
+    {
+        meshIds.push_back(meshIds.empty() ? boneId(numBones) : meshIds.back() + 3 + (int64_t)iter[-1].skeleton.bones.size());
+    }
+    auto geometryId = [&](int m) { return meshIds[m] + 1; };
+    auto skinId = [&](int m) { return meshIds[m] + 2; };
+    auto clusterId = [&](int m, int i) { return meshIds[m] + 3 + i; };
+    
+    // bone transforms as the SDK derives them from local translation, rotation and scaling
+    std::vector<FbxAMatrix> locals(numBones), globals(numBones);
+    for (auto i = 0; i < numBones; i++)
+    {
+        auto &pose = skeleton.poses[i];
+        FbxAMatrix mat(pose.position, pose.rotation, pose.scale);
+        locals[i] = FbxAMatrix(mat.GetT(), mat.GetR(), mat.GetS());
+    }
+    std::vector<char> evaluated(numBones, 0);
+    std::function<const FbxAMatrix &(int)> evaluate = [&](int i) -> const FbxAMatrix &
+    { // what EvaluateGlobalTransform() gives for nodes without pivots or inherit options
+        if (!evaluated[i])
+        {
+            auto parent = skeleton.nodes[i];
+            globals[i] = parent == -1 ? locals[i] : evaluate(parent) * locals[i];
+            evaluated[i] = 1;
+        }
+        return globals[i];
+    };
+    for (auto i = 0; i < numBones; i++) { evaluate(i); }
+    
+    std::vector<ClusterWeights> weights;
+    auto numDeformers = 0;
+    for (auto iter = meshes.begin(); iter != meshes.end(); iter++)
+    {
+        weights.emplace_back(iter->influences, skinned ? iter->poses.size() : 0);
+        for (auto i = 0; skinned && i < iter->skeleton.bones.size(); i++) { numDeformers += i < weights.back().size(); }
+        numDeformers += skinned;
+    }
+    
+    BinaryWriter writer;
+    if (!writer.open(savename))
+    {
+        output("[E] %s unable to write\n", savename.c_str());
+        return false;
+    }
+    
+    BinaryRecordWriter w(writer, options.version > 0 ? options.version : 7400, std::max(0, options.level), options.minsize < 0 ? 128 : options.minsize);
+    header(w);
+    definitions(w, {
+        {"Model", numMeshes + numBones},
+        {"Geometry", numMeshes},
+        {"Material", 1},
+        {"NodeAttribute", numBones},
+        {"Deformer", numDeformers},
+        {"Pose", skinned ? 1 : 0}
+    });
+    
+    w.begin("Objects");
+    
+    std::vector<double> values;
+    std::vector<int32_t> indices;
+    for (auto m = 0; m < numMeshes; m++)
+    {
+        auto &asset = meshes[m];
+        model(w, meshIds[m], asset.name, "Mesh");
+        w.record("Shading", true);
+        w.record("Culling", "CullingOff");
+        w.end();
+        
+        w.begin("Geometry");
+        w.add(geometryId(m));
+        w.add(name(asset.name, "Geometry"));
+        w.add("Mesh");
+        w.record("GeometryVersion", (int32_t)124);
+        values.clear();
+        for (auto iter = asset.vertices.begin(); iter != asset.vertices.end(); iter++) { values.insert(values.end(), iter->mData, iter->mData + 3); }
+        w.record("Vertices", values);
+        indices.resize(asset.triangles.size());
+        for (auto i = 0; i < asset.triangles.size(); i++)
+        {
+            auto index = (int32_t)asset.triangles[i];
+            indices[i] = i % 3 == 2 ? ~index : index; // last vertex of a polygon is stored negated
+        }
+        w.record("PolygonVertexIndex", indices);
+        
+        layer(w, "LayerElementNormal", 102, "Normals", "ByVertice", "Direct");
+        values.clear();
+        for (auto iter = asset.normals.begin(); iter != asset.normals.end(); iter++) { values.insert(values.end(), iter->mData, iter->mData + 3); }
+        w.record("Normals", values);
+        values.assign(asset.normals.size(), 1.0);
+        w.record("NormalsW", values);
+        w.end();
+        
+        layer(w, "LayerElementUV", 101, "UVs", "ByVertice", "Direct");
+        values.clear();
+        for (auto iter = asset.uvs.begin(); iter != asset.uvs.end(); iter++) { values.insert(values.end(), iter->mData, iter->mData + 2); }
+        w.record("UV", values);
+        w.end();
+        
+        layer(w, "LayerElementTangent", 102, "Tangents", "ByVertice", "Direct");
+        values.clear();
+        for (auto iter = asset.tangents.begin(); iter != asset.tangents.end(); iter++) { values.insert(values.end(), iter->mData, iter->mData + 3); }
+        w.record("Tangents", values);
+        values.clear();
+        for (auto iter = asset.tangents.begin(); iter != asset.tangents.end(); iter++) { values.push_back(iter->mData[3]); }
+        w.record("TangentsW", values);
+        w.end();
+        
+        layer(w, "LayerElementMaterial", 101, "", "AllSame", "IndexToDirect");
+        w.record("Materials", std::vector<int32_t>(1, 0));
+        w.end();
+        
+        w.begin("Layer");
+        w.add((int32_t)0);
+        w.record("Version", (int32_t)100);
+        const char *elements[] = {"LayerElementNormal", "LayerElementUV", "LayerElementTangent", "LayerElementMaterial"};
+        for (auto i = 0; i < 4; i++)
+        {
+            w.begin("LayerElement");
+            w.record("Type", elements[i]);
+            w.record("TypedIndex", (int32_t)0);
+            w.end();
+        }
+        w.end();
+        w.end();
+    }
+    
+    w.begin("Material");
+    w.add(materialId);
+    w.add(name("Lambert", "Material"));
+    w.add("");
+    w.record("Version", (int32_t)102);
+    w.record("ShadingModel", "Lambert");
+    w.record("MultiLayer", (int32_t)0);
+    w.begin("Properties70");
+    P(w, "EmissiveColor", "Color", "", "A", 0.0, 0.0, 0.0);
+    P(w, "AmbientColor", "Color", "", "A", 1.0, 1.0, 1.0);
+    P(w, "DiffuseColor", "Color", "", "A", 1.0, 1.0, 1.0);
+    P(w, "TransparencyFactor", "Number", "", "A", 0.0);
+    w.end();
+    w.end();
+    
+    for (auto i = 0; i < numBones; i++)
+    {
+        auto &name = skeleton.names[i];
+        auto root = skeleton.nodes[i] == -1;
+        
+        w.begin("NodeAttribute");
+        w.add(attributeId(i));
+        w.add(fbxwrite::name(name, "NodeAttribute"));
+        w.add(root ? "Root" : "Limb");
+        w.begin("TypeFlags");
+        if (root) { w.add("Null"); }
+        w.add("Skeleton");
+        if (root) { w.add("Root"); }
+        w.end();
+        w.end();
+        
+        model(w, boneId(i), name, root ? "Root" : "Limb");
+        w.begin("Properties70");
+        P(w, "Lcl Translation", locals[i].GetT());
+        P(w, "Lcl Rotation", locals[i].GetR());
+        P(w, "Lcl Scaling", locals[i].GetS());
+        w.end();
+        w.record("Shading", true);
+        w.record("Culling", "CullingOff");
+        w.end();
+    }
+    
+    FbxAMatrix identity;
+    for (auto m = 0; skinned && m < numMeshes; m++)
+    {
+        auto &bones = meshes[m].skeleton.bones;
+        w.begin("Deformer");
+        w.add(skinId(m));
+        w.add(name("Skin", "Deformer"));
+        w.add("Skin");
+        w.record("Version", (int32_t)101);
+        w.record("Link_DeformAcuracy", 50.0);
+        w.end();
+        
+        for (auto i = 0; i < bones.size(); i++)
+        {
+            if (i >= weights[m].size()) { continue; }
             
-            auto cluster = FbxCluster::Create(scene, name.c_str());
-            cluster->SetLink(bone);
-            cluster->SetLinkMode(FbxCluster::eNormalize);
-            cluster->SetTransformLinkMatrix(bone->EvaluateGlobalTransform());
+            auto index = bones[i];
+            w.begin("Deformer");
+            w.add(clusterId(m, i));
+            w.add(name(skeleton.names[index], "SubDeformer"));
+            w.add("Cluster");
+            w.record("Version", (int32_t)100);
+            w.begin("UserData");
+            w.add("");
+            w.add("");
+            w.end();
             
-            auto &cluster_weights = weights[i];
-            cluster->SetControlPointIWCount(static_cast<int>(cluster_weights.size()));
-            for (auto iter = cluster_weights.begin(); iter != cluster_weights.end(); iter++)
-            {
-                cluster->AddControlPointIndex(iter->first, iter->second);
-            }
+            w.begin("Indexes");
+            w.add(weights[m].vertices(i), weights[m].count(i));
+            w.end();
+            w.begin("Weights");
+            w.add(weights[m].weights(i), weights[m].count(i));
+            w.end();
             
-            skin->AddCluster(cluster);
+            w.begin("Transform");
+            w.add((const double *)identity, 16);
+            w.end();
+            w.begin("TransformLink");
+            w.add((const double *)globals[index], 16);
+            w.end();
+            w.end();
         }
-        
-        mesh->AddDeformer(skin);
     }
     
-    auto layer = mesh->GetLayer(0);
-    if (!layer)
+    if (skinned)
     {
-        mesh->CreateLayer();
-        layer = mesh->GetLayer(0);
+        w.begin("Pose");
+        w.add(poseId);
+        w.add(name("BindPose", "Pose"));
+        w.add("BindPose");
+        w.record("Type", "BindPose");
+        w.record("Version", (int32_t)100);
+        w.record("NbPoseNodes", (int32_t)numBones);
+        for (auto i = 0; i < numBones; i++)
+        {
+            w.begin("PoseNode");
+            w.record("Node", boneId(i));
+            w.begin("Matrix");
+            w.add((const double *)globals[i], 16);
+            w.end();
+            w.end();
+        }
+        w.end();
     }
+    w.end();
     
-    auto material = FbxSurfaceLambert::Create(manager, "Lambert");
-    material->ShadingModel.Set("Lambert");
-    material->Emissive.Set(FbxDouble3(0, 0, 0));
-    material->Ambient.Set(FbxDouble3(1, 1, 1));
-    material->Diffuse.Set(FbxDouble3(1, 1, 1));
-    material->TransparencyFactor.Set(0);
-    meshNode->AddMaterial(material);
+    w.begin("Connections");
+    for (auto m = 0; m < numMeshes; m++)
+    {
+        connect(w, meshIds[m], 0);
+        connect(w, geometryId(m), meshIds[m]);
+        connect(w, materialId, meshIds[m]);
+    }
+    for (auto i = 0; i < numBones; i++)
+    {
+        auto parent = skeleton.nodes[i];
+        connect(w, boneId(i), parent == -1 ? 0 : boneId(parent));
+        connect(w, attributeId(i), boneId(i));
+    }
+    for (auto m = 0; skinned && m < numMeshes; m++)
+    {
+        auto &bones = meshes[m].skeleton.bones;
+        connect(w, skinId(m), geometryId(m));
+        for (auto i = 0; i < bones.size(); i++)
+        {
+            if (i >= weights[m].size()) { continue; }
+            connect(w, clusterId(m, i), skinId(m));
+            connect(w, boneId(bones[i]), clusterId(m, i));
+        }
+    }
+    w.end();
     
-    // vertices
-    mesh->InitControlPoints(static_cast<int>(vertices.size()));
-    for (auto i = 0; i < vertices.size(); i++) { mesh->SetControlPointAt(vertices[i], i); }
-    for (auto iter = triangles.begin(); iter != triangles.end();)
+    w.begin("Takes");
+    w.record("Current", "");
+    w.end();
+    
+    w.footer(footerId);
+    if (!writer.close())
     {
-        mesh->BeginPolygon();
-        mesh->AddPolygon(*iter++);
-        mesh->AddPolygon(*iter++);
-        mesh->AddPolygon(*iter++);
-        mesh->EndPolygon();
+        output("[E] %s unable to write\n", savename.c_str());
+        return false;
     }
     
-    { // normals
-        auto element = FbxLayerElementNormal::Create(mesh, "Normals");
-        element->SetMappingMode(FbxLayerElement::eByControlPoint);
-        element->SetReferenceMode(FbxLayerElement::eDirect);
-        for (auto iter = normals.begin(); iter != normals.end(); iter++)
+    produced(savename);
+    output(">> %s\n", savename.c_str());
+    return true;
+}
+
+// where a mesh record sits in the database
+struct MeshRecord
+{
+    std::string name;
+    uint64_t offset = 0; // record key ahead of the mesh
+    uint64_t size = 0;
+    uint64_t hash = 0;   // ContentHash of record bytes
+    uint64_t skeleton = 0; // ContentHash of skeleton nodes, names and poses, 0 without skeleton
+};
+
+// sidecar index <database>.idx, one line per record after a header naming the database size and mtime
+//   fbxgen-index 2 <size> <mtime>
+//   <offset> <size> <hash> <skeleton> <name>
+namespace database
+{
+    // bounds checked walk over the mapped database, sizes are those FileStream reads
+    class Cursor
+    {
+        const char *__p;
+        const char *__end;
+        bool __good = true;
+        
+    public:
+        Cursor(const char *data, size_t size): __p(data), __end(data + size) {}
+        
+        bool good() const { return __good; }
+        const char *position() const { return __p; }
+        
+        void skip(uint64_t size)
         {
-            element->GetDirectArray().Add(*iter);
+            if (!__good || size > (uint64_t)(__end - __p)) { __good = false; return; }
+            __p += size;
         }
-        layer->SetNormals(element);
+        
+        uint32_t count()
+        {
+            uint32_t v = 0;
+            if (__good && __end - __p >= 4) { memcpy(&v, __p, 4); }
+            skip(4);
+            return v;
+        }
+        
+        std::string string()
+        {
+            auto size = count();
+            auto start = __p;
+            skip(size);
+            return __good ? std::string(start, size) : std::string();
+        }
+        
+        void array(size_t stride) { auto n = count(); skip((uint64_t)n * stride); }
+    };
+    
+    bool scan(const std::string &filename, std::vector<MeshRecord> &records)
+    {
+        MappedFile file;
+        if (!file.open(filename)) { return false; }
+        
+        Cursor cursor(file.data(), file.size());
+        cursor.count();
+        cursor.string();
+        cursor.string();
+        auto count = cursor.count();
+        
+        records.clear();
+        for (auto i = 0; i < count && cursor.good(); i++)
+        {
+            auto start = cursor.position();
+            MeshRecord record;
+            record.offset = start - file.data();
+            
+            cursor.string();
+            record.name = cursor.string();
+            cursor.skip(6 * 4);  // aabb
+            cursor.array(16 * 4); // poses
+            cursor.array(sizeof(BoneInfluence));
+            cursor.array(3 * 4);  // vertices
+            cursor.array(4);      // triangles
+            cursor.array(4 * 4);  // tangents
+            cursor.array(3 * 4);  // normals
+            cursor.array(2 * 4);  // uvs
+            
+            auto skeleton = cursor.position();
+            auto nodes = cursor.count();
+            cursor.skip((uint64_t)nodes * 4);
+            auto names = cursor.count();
+            for (auto n = 0; n < names && cursor.good(); n++) { cursor.string(); }
+            cursor.array(10 * 4); // skeleton poses
+            auto bones = cursor.position();
+            cursor.array(4);      // skeleton bones
+            if (!cursor.good()) { break; }
+            
+            record.size = cursor.position() - start;
+            record.hash = ContentHash().update(start, record.size).digest();
+            if (nodes > 0) { record.skeleton = ContentHash().update(skeleton, bones - skeleton).digest(); }
+            records.push_back(record);
+        }
+        return cursor.good();
     }
     
-    { // uvs
-        auto element = FbxLayerElementUV::Create(mesh, "UVs");
-        element->SetMappingMode(FbxLayerElement::eByControlPoint);
-        element->SetReferenceMode(FbxLayerElement::eDirect);
-        for (auto iter = uvs.begin(); iter != uvs.end(); iter++)
+    bool load(const std::string &filename, const struct stat &st, std::vector<MeshRecord> &records)
+    {
+        std::ifstream stream(filename + ".idx");
+        std::string magic;
+        int version = 0;
+        long long size = 0, mtime = 0;
+        if (!(stream >> magic >> version >> size >> mtime)) { return false; }
+        if (magic != "fbxgen-index" || version != 2 || size != st.st_size || mtime != cache::mtime(st)) { return false; }
+        
+        records.clear();
+        MeshRecord record;
+        std::string hash, skeleton;
+        while (stream >> record.offset >> record.size >> hash >> skeleton)
         {
-            element->GetDirectArray().Add(*iter);
+            stream.get();
+            if (!getline(stream, record.name)) { return false; }
+            record.hash = strtoull(hash.c_str(), nullptr, 16);
+            record.skeleton = strtoull(skeleton.c_str(), nullptr, 16);
+            records.push_back(record);
         }
-        layer->SetUVs(element);
+        return stream.eof();
     }
     
-    { // tangents
-        auto element = FbxLayerElementTangent::Create(mesh, "Tangents");
-        element->SetMappingMode(FbxLayerElement::eByControlPoint);
-        element->SetReferenceMode(FbxLayerElement::eDirect);
-        for (auto iter = tangents.begin(); iter != tangents.end(); iter++)
+    void save(const std::string &filename, const struct stat &st, const std::vector<MeshRecord> &records)
+    {
+        auto temporary = filename + ".idx." + std::to_string(getpid());
         {
-            element->GetDirectArray().Add(*iter);
+            std::ofstream stream(temporary);
+            stream << "fbxgen-index 2 " << (long long)st.st_size << " " << cache::mtime(st) << "\n";
+            for (auto iter = records.begin(); iter != records.end(); iter++)
+            {
+                stream << iter->offset << " " << iter->size << " " << ContentHash::hex(iter->hash) << " " << ContentHash::hex(iter->skeleton) << " " << iter->name << "\n";
+            }
+            if (!stream.good()) { unlink(temporary.c_str()); return; }
         }
-        layer->SetTangents(element);
+        if (rename(temporary.c_str(), (filename + ".idx").c_str()) != 0) { unlink(temporary.c_str()); }
     }
     
-    std::string error;
-    std::string savename(name + ".fbx");
-    auto exporter = FbxExporter::Create(manager, "");
-    if (!exporter->Initialize(savename.c_str(), -1, manager->GetIOSettings()))
+    // sidecar if it still describes the database, otherwise a new scan written back
+    bool index(const std::string &filename, std::vector<MeshRecord> &records)
     {
-        error = exporter->GetStatus().GetErrorString();
-        manager->Destroy();
-        return;
+        struct stat st;
+        if (stat(filename.c_str(), &st) != 0) { return false; }
+        if (load(filename, st, records)) { return true; }
+        if (!scan(filename, records)) { return false; }
+        save(filename, st, records);
+        return true;
     }
-    if (!exporter->Export(scene))
+    
+    // ?mesh=pattern[,pattern...] with fnmatch globs over mesh names
+    bool match(const std::string &patterns, const std::string &name)
     {
-        error = exporter->GetStatus().GetErrorString();
-        manager->Destroy();
-        return;
+        std::string pattern;
+        std::stringstream stream(patterns);
+        while (getline(stream, pattern, ','))
+        {
+            if (fnmatch(pattern.c_str(), name.c_str(), 0) == 0) { return true; }
+        }
+        return false;
     }
-    printf(">> %s\n", savename.c_str());
+}
+
+FbxManager *createManager()
+{
+    FbxManager* manager = FbxManager::Create();
+    manager->SetIOSettings(FbxIOSettings::Create(manager, IOSROOT));
+    return manager;
+}
+
+void destroyManager(FbxManager *manager)
+{
     manager->Destroy();
 }
 
-void load_mesh_database(const char* filename)
+// ?sdk builds every mesh as an SDK scene and exports it, ?verify times and compares its bulk filled points and layers, ?zlib[=level] compresses arrays of the native writer
+// as ?compresslevel does, ?format=ascii always goes through the SDK, see ExportOptions for the rest
+// ?mesh=pattern seeks straight to the matching records through the sidecar index, ?index only refreshes it
+// ?group writes skinned meshes sharing the same skeleton into one scene named after its root bone, bones are built once
+// scenes are written next to the database, as other tools write next to their inputs, so served jobs land beside the client's file
+// with ?threads=N other than 1 this thread only reads meshes, workers with a manager each for their lifetime build
+// and write them, at most two scenes per worker wait in memory and logs come out in database order
+bool load_mesh_database(const char* filename, FbxManager *manager, ArgumentOptions &args, int threads)
 {
+    std::string value;
+    ExportOptions exports(args);
+    if (args.get("zlib", value)) { exports.level = value.empty() ? 6 : atoi(value.c_str()); } // zlib's default level
+    if (exports.compatibility() == nullptr)
+    {
+        output("[E] unsupported FBX version %d\n", exports.version);
+        return false;
+    }
+    
+    auto sdk = args.get("sdk") || exports.ascii();
+    auto verify = args.get("verify");
+    
+    std::string directory = archive::workpath(filename);
+    directory = directory.substr(0, directory.rfind('/') + 1);
+    
+    std::string patterns;
+    auto filtered = args.get("mesh", patterns);
+    auto grouped = args.get("group");
+    std::vector<MeshRecord> records, selected;
+    if (filtered || grouped || args.get("index"))
+    {
+        if (!database::index(filename, records))
+        {
+            output("[E] %s broken mesh database\n", filename);
+            return false;
+        }
+        
+        for (auto iter = records.begin(); iter != records.end(); iter++)
+        {
+            if (!filtered || database::match(patterns, iter->name)) { selected.push_back(*iter); }
+        }
+        
+        if (!filtered && !grouped)
+        {
+            output(">> %s.idx %d meshes\n", filename, (int)records.size());
+            return true;
+        }
+        if (filtered) { output("%d of %d meshes match %s\n", (int)selected.size(), (int)records.size(), patterns.c_str()); }
+    }
+    
     FileStream fs(filename, std::ios_base::in);
-    if (!fs.good()) {return;}
+    if (!fs.good()) {return false;}
     
     fs.read<uint32_t>();
     fs.read<std::string>();
     fs.read<std::string>();
     
-    auto count = fs.read<uint32_t>();
+    uint32_t count = fs.read<uint32_t>();
+    auto seeking = filtered || grouped;
+    if (seeking) { count = (uint32_t)selected.size(); }
+    
+    // one mesh per scene, or with ?group the meshes of each skeleton in the order the skeletons first appear
+    std::vector<std::vector<int>> scenes;
+    std::map<uint64_t, size_t> skeletons;
     for (auto i = 0; i < count; i++)
     {
-        fs.read<std::string>();
-        generate_meshfbx(fs);
+        auto skeleton = grouped ? selected[i].skeleton : 0;
+        if (skeleton == 0) { scenes.push_back(std::vector<int>(1, i)); continue; }
+        
+        auto match = skeletons.find(skeleton);
+        if (match == skeletons.end()) { match = skeletons.insert(std::make_pair(skeleton, scenes.size())).first; scenes.emplace_back(); }
+        scenes[match->second].push_back(i);
     }
+    if (grouped) { output("%d meshes in %d scenes\n", (int)count, (int)scenes.size()); }
+    
+    // records follow one another unless the index picked or regrouped them
+    auto next = [&](const std::vector<int> &scene, std::vector<MeshAsset> &meshes, std::string &savename)
+    {
+        meshes.resize(scene.size());
+        for (auto n = 0; n < scene.size(); n++)
+        {
+            if (seeking) { fs.seek(selected[scene[n]].offset, std::ios_base::beg); }
+            fs.read<std::string>();
+            read_mesh(fs, meshes[n]);
+        }
+        
+        savename = directory + meshes.front().name;
+        if (meshes.size() > 1)
+        {
+            auto &skeleton = meshes.front().skeleton;
+            auto root = std::find(skeleton.nodes.begin(), skeleton.nodes.end(), -1) - skeleton.nodes.begin();
+            savename = directory + (root < skeleton.names.size() ? skeleton.names[root] : "Skeleton") + "_" + ContentHash::hex(selected[scene[0]].skeleton).substr(0, 8);
+        }
+        savename += ".fbx";
+    };
+    
+    auto failures = 0; // any export gone wrong fails the database
+    if (threads <= 1 || scenes.size() <= 1)
+    {
+        for (auto iter = scenes.begin(); iter != scenes.end(); iter++)
+        {
+            std::vector<MeshAsset> meshes;
+            std::string savename;
+            next(*iter, meshes, savename);
+            auto success = sdk ? generate_meshfbx(meshes, savename, manager, exports, verify) : write_meshfbx(meshes, savename, exports);
+            if (!success) { ++failures; }
+        }
+        return fs.good() && failures == 0;
+    }
+    
+    // files and counters of meshes go to the job running this database
+    auto parent = jobs::__record;
+    std::mutex mutex;
+    long long peak = 0;
+    
+    OrderedOutput logs(console::__buffer);
+    Throttle throttle(threads * 2);
+    {
+        WorkerPool<FbxManager> pool(std::min(threads, (int)scenes.size()),
+                                    sdk ? std::function<FbxManager *()>(createManager) : nullptr,
+                                    sdk ? std::function<void(FbxManager *)>(destroyManager) : nullptr);
+        for (auto iter = scenes.begin(); iter != scenes.end() && fs.good(); iter++)
+        {
+            auto meshes = std::make_shared<std::vector<MeshAsset>>();
+            auto savename = std::make_shared<std::string>();
+            next(*iter, *meshes, *savename);
+            
+            throttle.acquire();
+            auto slot = logs.open();
+            pool.submit([&, meshes, savename, slot](FbxManager *context)
+            {
+                JobRecord record;
+                ConsoleCapture capture;
+                {
+                    JobScope scope(record);
+                    MemoryScope usage;
+                    auto success = sdk ? generate_meshfbx(*meshes, *savename, context, exports, verify) : write_meshfbx(*meshes, *savename, exports);
+                    
+                    std::lock_guard<std::mutex> lock(mutex);
+                    if (!success) { ++failures; }
+                    peak = std::max(peak, usage.peak());
+                }
+                
+                if (parent != nullptr)
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    parent->outputs.insert(parent->outputs.end(), record.outputs.begin(), record.outputs.end());
+                    for (auto iter = record.counters.begin(); iter != record.counters.end(); iter++) { parent->counters[iter->first] += iter->second; }
+                }
+                
+                logs.close(slot, capture.text());
+                throttle.release();
+            });
+        }
+        pool.join();
+    }
+    
+    // SDK memory of workers isn't seen by this thread, largest mesh times workers is what the budget should expect
+    tally("memory", peak * std::min(threads, (int)scenes.size()));
+    return fs.good() && failures == 0;
 }
 
-int main(int argc, const char * argv[])
+// ?skinbench=N buckets the influences of a synthetic skinned mesh of N vertices, 1M by default,
+// through per bone std::map as before and through ClusterWeights, then fills the clusters of an SDK skin
+bool benchmark(FbxManager *manager, int numVertices)
 {
-    for (auto i = 1; i < argc; i++)
+    const auto numBones = 64;
+    std::vector<BoneInfluence> influences(numVertices);
+    uint32_t seed = 1;
+    auto random = [&]() { seed = seed * 1664525 + 1013904223; return seed >> 8; };
+    for (auto iter = influences.begin(); iter != influences.end(); iter++)
+    {
+        auto used = 1 + random() % 4; // trailing slots carry zero weights as exported
+        for (auto i = 0; i < 4; i++)
+        {
+            iter->indices[i] = i < used ? random() % numBones : 0;
+            iter->weights[i] = i < used ? 1.0f / used : 0;
+        }
+    }
+    
+    Stopwatch watch;
+    {
+        std::vector<std::map<int, float>> weights(numBones);
+        auto vertex = 0;
+        for (auto iter = influences.begin(); iter != influences.end(); iter++, vertex++)
+        {
+            for (auto i = 0; i < 4; i++) { weights[iter->indices[i]][vertex] = iter->weights[i]; }
+        }
+    }
+    auto map = watch.elapsed();
+    
+    watch.reset();
+    ClusterWeights weights(influences, numBones);
+    auto flat = watch.elapsed();
+    
+    watch.reset();
+    auto scene = FbxScene::Create(manager, "Scene");
+    auto skin = FbxSkin::Create(scene, "Skin");
+    for (auto i = 0; i < numBones; i++)
     {
-        printf("[%d] %s\n", i, argv[i]);
-        load_mesh_database(argv[i]);
+        auto cluster = FbxCluster::Create(scene, "");
+        fill(cluster, weights, i);
+        skin->AddCluster(cluster);
     }
-    return 0;
+    auto filled = watch.elapsed();
+    scene->Destroy(true); // skin and clusters too, the manager outlives this job under --serve
+    
+    output("[skinbench] vertices=%d bones=%d map=%.3fs flat=%.3fs fill=%.3fs peak=%.1fMB\n", numVertices, numBones, map, flat, filled, peakMemory());
+    return true;
+}
+
+int main(int argc, const char * argv[])
+{
+    CommandOptions options(argc, argv);
+    memory::install();
+    
+    ToolDriver<FbxManager> tool;
+    tool.name = "fbxgen";
+    tool.version = FBXTOOLS_VERSION " " FBXSDK_VERSION_STRING;
+    tool.create = createManager;
+    tool.destroy = destroyManager;
+    tool.announce = [](ArgumentOptions &args, int i, int count)
+    {
+        output("[%d] %s\n", i + 1, args.filename.c_str());
+    };
+    tool.process = [&](FbxManager *manager, ArgumentOptions &args)
+    {
+        std::string value;
+        if (args.get("skinbench", value)) { return benchmark(manager, value.empty() ? 1000000 : std::max(1, atoi(value.c_str()))); }
+        
+        auto threads = args.get("threads", value) ? atoi(value.c_str()) : 0;
+        if (threads <= 0) { threads = std::max(1, (int)std::thread::hardware_concurrency() / options.jobs); }
+        return load_mesh_database(args.filename.c_str(), manager, args, threads);
+    };
+    
+    return drive(tool, options);
 }
@@ -0,0 +1,306 @@
+//
+//  main.cpp
+//  fbxscan
+//
+//  Created by LARRYHOU on 2026/10/19.
+//  Copyright © 2026 LARRYHOU. All rights reserved.
+//
+
+#include <stdio.h>
+#include <map>
+#include <string>
+#include <vector>
+#include <arguments.h>
+#include <workers.h>
+#include <cache.h>
+#include <driver.h>
+#include <filestream.h>
+#include <fbxbinary.h>
+#include <conversion.h>
+
+// same numbers as fbxdump ?check, read straight from binary FBX records without the FBX SDK
+struct MeshStatistics
+{
+    int vertices;
+    int polygons;
+    int triangles;
+    
+    MeshStatistics(int v, int p, int t): vertices(v), polygons(p), triangles(t) {}
+    MeshStatistics(): MeshStatistics(0, 0, 0) {}
+    
+    MeshStatistics& operator+=(MeshStatistics v)
+    {
+        vertices += v.vertices;
+        polygons += v.polygons;
+        triangles += v.triangles;
+        return *this;
+    }
+};
+
+struct FileOptions: public ArgumentOptions
+{
+    bool mesh;
+    int threads = 0; // inflating arrays of a geometry, 0 for cores left per job
+    
+    FileOptions(const ArgumentOptions &args): ArgumentOptions(args)
+    {
+        std::string value;
+        if (get("threads", value)) { threads = atoi(value.c_str()); }
+        mesh = get("mesh");
+    }
+};
+
+// polygon ends are stored as negative indices, only compressed arrays have to be inflated
+bool measure(const BinaryDocument &document, const BinaryRecord &geometry, MeshStatistics &stat)
+{
+    stat = MeshStatistics();
+    
+    std::vector<BinaryProperty> properties;
+    BinaryRecord vertices;
+    if (document.find(geometry, "Vertices", vertices))
+    {
+        if (!document.properties(vertices, properties) || properties.empty() || !properties[0].array()) { return false; }
+        stat.vertices = properties[0].length / 3;
+    }
+    
+    BinaryRecord polygons;
+    if (!document.find(geometry, "PolygonVertexIndex", polygons)) { return true; }
+    if (!document.properties(polygons, properties) || properties.empty() || properties[0].type != 'i') { return false; }
+    
+    auto &indices = properties[0];
+    std::vector<char> buffer;
+    auto data = indices.data;
+    if (indices.encoding != 0)
+    {
+        if (!indices.bytes(buffer)) { return false; }
+        data = buffer.data();
+    }
+    else if (indices.size != indices.length * 4) { return false; }
+    
+    auto count = 0;
+    for (uint32_t i = 0; i < indices.length; i++)
+    {
+        if (fbxbinary::read<int32_t>(data + i * 4) < 0) { ++count; }
+    }
+    
+    stat.polygons = count;
+    stat.triangles = indices.length - 2 * count;
+    return true;
+}
+
+std::string createWorkspace(const std::string &filename)
+{
+    auto path = archive::workpath(filename);
+    auto pos = path.rfind('.');
+    std::string workspace = path.substr(0, pos) + ".fbm";
+    mkdir(workspace.c_str(), 0777);
+    return workspace;
+}
+
+// FbxVector4, FbxVector2 and FbxColor are all written as floats, missing w is 1 as in FbxVector4 unless given
+void encode(FileStream &fs, const std::vector<double> &data, int stride, int components, const std::vector<double> &w, double missing = 1)
+{
+    auto count = data.size() / stride;
+    for (size_t i = 0; i < count; i++)
+    {
+        auto ptr = data.data() + i * stride;
+        for (auto n = 0; n < components; n++)
+        {
+            auto v = n < stride ? ptr[n] : (i < w.size() ? w[i] : missing);
+            fs.write<float>(static_cast<float>(v));
+        }
+    }
+}
+
+void encode(FileStream &fs, const BinaryLayer &layer, int components)
+{
+    fs.write<char>('d');
+    fs.write<char>(layer.mapping);
+    fs.write<int>((int)(layer.directs.size() / layer.stride));
+    fs.alginp();
+    encode(fs, layer.directs, layer.stride, components, layer.w);
+    
+    auto flag = layer.reference == 2; // FbxLayerElement::eIndexToDirect
+    fs.write<bool>(flag); // index mapping
+    if (flag)
+    {
+        fs.write('i');
+        fs.write<int>((int)layer.indices.size());
+        fs.alginp();
+        fs.write<int>(layer.indices.data(), layer.indices.size());
+    }
+}
+
+// same bytes as exportMesh() of fbxdump, points are in meters already and w carries the unit scale
+void exportMesh(const BinaryGeometry &data, double scale, const std::string &filename)
+{
+    FileStream fs(filename.c_str());
+    fs.write('M');
+    fs.write('E');
+    fs.write('S');
+    fs.write('H');
+    // vertices
+    fs.write('V');
+    fs.write<int>((int)(data.points.size() / 3));
+    fs.alginp();
+    encode(fs, data.points, 3, 4, std::vector<double>(), scale);
+    
+    // triangles, counted ahead so there is nothing to patch afterwards
+    auto numTriangles = 0;
+    for (auto iter = data.polygons.begin(); iter != data.polygons.end(); iter++) { numTriangles += std::max(0, *iter - 2); }
+    fs.write('T');
+    fs.write<int>(numTriangles);
+    fs.alginp();
+    auto numPolygonVertices = 0;
+    for (auto iter = data.polygons.begin(); iter != data.polygons.end(); iter++)
+    {
+        auto size = *iter;
+        auto anchor = numPolygonVertices;
+        for (auto t = 0; t < size; t++) // auto split polygons with more than 3 vertices
+        {
+            if (t > 0 && t < size - 1)
+            {
+                fs.write<int>(anchor);
+                fs.write<int>(numPolygonVertices);
+                fs.write<int>(numPolygonVertices + 1);
+            }
+            numPolygonVertices++;
+        }
+    }
+    
+    // encode polygon vertices
+    fs.write<char>('P');
+    fs.write<int>((int)data.vertices.size());
+    fs.alginp();
+    fs.write<int>(data.vertices.data(), data.vertices.size());
+    fs.write<char>('Z');
+    
+    if (data.normals.valid)
+    {
+        fs.write<char>('n');
+        encode(fs, data.normals, 4);
+    }
+    
+    if (data.tangents.valid)
+    {
+        fs.write<char>('t');
+        encode(fs, data.tangents, 4);
+    }
+    
+    if (data.colors.valid)
+    {
+        fs.write<char>('c');
+        encode(fs, data.colors, 4);
+    }
+    
+    if (data.uvs.valid)
+    {
+        fs.write<char>('u');
+        encode(fs, data.uvs, 2);
+    }
+}
+
+bool scan(FileOptions &fo, MeshStatistics &stat)
+{
+    BinaryDocument document;
+    std::string error;
+    if (!document.open(fo.filename, error))
+    {
+        output("%s: %s\n", fo.filename.c_str(), error.c_str());
+        return false;
+    }
+    
+    BinaryScene scene;
+    if (!scene.load(document))
+    {
+        output("%s: broken objects\n", fo.filename.c_str());
+        return false;
+    }
+    
+    auto &objects = scene.objects();
+    std::map<int64_t, MeshStatistics> meshes;
+    for (auto iter = objects.begin(); iter != objects.end(); iter++)
+    {
+        auto &model = iter->second;
+        if (!model.model || model.content < 0 || !scene.reachable(iter->first)) { continue; }
+        
+        auto &geometry = objects[model.content];
+        if (!geometry.mesh) { continue; }
+        
+        auto match = meshes.find(model.content);
+        if (match == meshes.end())
+        {
+            MeshStatistics mesh;
+            if (!measure(document, geometry.record, mesh))
+            {
+                output("%s: broken geometry %lld\n", fo.filename.c_str(), (long long)model.content);
+                return false;
+            }
+            match = meshes.insert(std::make_pair(model.content, mesh)).first;
+        }
+        stat += match->second;
+    }
+    
+    if (!fo.mesh) { return true; }
+    
+    auto workspace = createWorkspace(fo.filename);
+    auto scale = scene.unitScaleFactor() / 100;
+    auto conversion = CoordinateConversion(nullptr, scale); // to meters
+    GeometryReader reader(document, fo.threads);
+    auto success = reader.read(scene, [&](const BinaryObject &geometry, BinaryGeometry &data)
+    {
+        // named after the geometry, or the first model holding it as FbxMesh::GetNode() does
+        auto name = geometry.name;
+        if (name.empty() && geometry.owner >= 0) { name = objects[geometry.owner].name; }
+        
+        auto filename = workspace + "/" + name + ".mesh";
+        conversion.points(data.points.data(), data.points.size() / 3);
+        exportMesh(data, scale, filename);
+        produced(filename);
+        return true;
+    });
+    
+    if (!success) { output("%s: broken geometry\n", fo.filename.c_str()); }
+    return success;
+}
+
+int main(int argc, const char * argv[])
+{
+    CommandOptions options(argc, argv);
+    
+    auto count = static_cast<int>(options.files.size());
+    std::vector<MeshStatistics> stats(count);
+    
+    ToolDriver<void> tool;
+    tool.name = "fbxscan";
+    tool.version = FBXTOOLS_VERSION;
+    tool.process = [&](void *, ArgumentOptions &args)
+    {
+        FileOptions fo(args);
+        if (fo.threads <= 0) { fo.threads = std::max(1, (int)std::thread::hardware_concurrency() / options.jobs); }
+        
+        MeshStatistics stat;
+        if (!scan(fo, stat)) { return false; }
+        output("%s %d %d %d\n", fo.filename.c_str(), stat.vertices, stat.polygons, stat.triangles);
+        
+        tally("vertices", stat.vertices);
+        tally("polygons", stat.polygons);
+        tally("triangles", stat.triangles);
+        return true;
+    };
+    tool.finished = [&](int i, ArgumentOptions &, JobRecord &record)
+    {
+        auto &counters = record.counters;
+        stats[i] = MeshStatistics((int)counters["vertices"], (int)counters["polygons"], (int)counters["triangles"]);
+    };
+    
+    auto result = drive(tool, options);
+    if (options.serve.empty() && count > 1)
+    {
+        MeshStatistics statistics;
+        for (auto iter = stats.begin(); iter != stats.end(); iter++) { statistics += *iter; }
+        printf("[] vertices=%d polygons=%d triangles=%d\n", statistics.vertices, statistics.polygons, statistics.triangles);
+    }
+    
+    return result;
+}
@@ -9,9 +9,17 @@
 #include <iostream>
 #include <fbxsdk.h>
 #include <fbxsdk/core/fbxdatatypes.h>
+#include <set>
 #include <string>
 #include <vector>
 
+#include <arguments.h>
+#include <workers.h>
+#include <cache.h>
+#include <streams.h>
+#include <driver.h>
+#include <fbxbinary.h>
+
 void trim(FbxMesh *mesh)
 {
     auto count = 0;
@@ -61,56 +69,245 @@ void trim(FbxScene *scene)
     }
 }
 
-void process(std::string filename, FbxManager *pManager)
+// byte level trimming of binary FBX, records are copied as they are except for the ones dropped below
+// and end offsets that move with them
+class BinaryTrimmer
 {
-    auto importer = FbxImporter::Create(pManager, "");
-    if (!importer->Initialize(filename.c_str(), -1, pManager->GetIOSettings()))
+    const BinaryDocument &__document;
+    BinaryWriter &__writer;
+    std::set<int64_t> __objects; // Material, Texture and Video objects
+    std::set<std::string> __types;
+    int64_t __definitions = 0; // objects gone from Definitions
+    
+    static bool trimmed(const std::string &type)
+    {
+        return type == "Material" || type == "Texture" || type == "Video";
+    }
+    
+    static bool element(const std::string &type)
+    {
+        return type == "LayerElementColor" || type == "LayerElementMaterial";
+    }
+    
+    std::string text(const BinaryRecord &record, const char *name)
+    {
+        BinaryProperty value;
+        return fbxbinary::value(__document, record, name, value) ? value.string() : std::string();
+    }
+    
+    bool dropped(const BinaryRecord &record, const BinaryRecord *parent)
+    {
+        if (parent == nullptr) { return record.is("Takes"); }
+        
+        std::vector<BinaryProperty> properties;
+        if (parent->is("Objects")) { return trimmed(record.label()); }
+        if (parent->is("Geometry")) { return element(record.label()); }
+        if (parent->is("Layer")) { return record.is("LayerElement") && element(text(record, "Type")); }
+        if (parent->is("Definitions"))
+        {
+            return record.is("ObjectType") && __document.properties(record, properties) && !properties.empty() && __types.count(properties[0].string()) != 0;
+        }
+        if (parent->is("Connections"))
+        {
+            if (!record.is("C") || !__document.properties(record, properties) || properties.size() < 3) { return false; }
+            return __objects.count(properties[1].integer()) != 0 || __objects.count(properties[2].integer()) != 0;
+        }
+        return false;
+    }
+    
+    bool copy(const BinaryRecord &record, const BinaryRecord *parent)
     {
-        return;
+        auto version = __document.version();
+        auto data = __document.data();
+        auto position = fbxbinary::begin(__writer, version, record.propertyCount, record.propertyBytes, record.name, record.nameLength);
+        
+        std::vector<BinaryProperty> properties;
+        if (parent != nullptr && parent->is("Definitions") && record.is("Count") && __document.properties(record, properties) && properties.size() == 1 && properties[0].type == 'I')
+        {
+            __writer.write<char>('I');
+            __writer.write<int32_t>((int32_t)(properties[0].integer() - __definitions));
+        }
+        else
+        {
+            __writer.write(data + record.properties, record.propertyBytes);
+        }
+        
+        if (record.end > record.children)
+        {
+            std::vector<BinaryRecord> children;
+            if (!__document.children(record, children)) { return false; }
+            for (auto iter = children.begin(); iter != children.end(); iter++)
+            {
+                if (dropped(*iter, &record)) { continue; }
+                if (!copy(*iter, &record)) { return false; }
+            }
+            __writer.fill(__document.headerSize());
+        }
+        
+        fbxbinary::end(__writer, version, position);
+        return true;
     }
+
+public:
+    BinaryTrimmer(const BinaryDocument &document, BinaryWriter &writer): __document(document), __writer(writer) {}
     
-    auto scene = FbxScene::Create(pManager, "Scene");
+    bool trim()
+    {
+        std::vector<BinaryRecord> roots, records;
+        std::vector<BinaryProperty> properties;
+        if (!__document.roots(roots)) { return false; }
+        
+        BinaryRecord section;
+        if (__document.find("Objects", section) && __document.children(section, records))
+        {
+            for (auto iter = records.begin(); iter != records.end(); iter++)
+            {
+                if (!trimmed(iter->label()) || !__document.properties(*iter, properties) || properties.empty()) { continue; }
+                __objects.insert(properties[0].integer());
+                __types.insert(iter->label());
+            }
+        }
+        
+        if (__document.find("Definitions", section) && __document.children(section, records))
+        {
+            for (auto iter = records.begin(); iter != records.end(); iter++)
+            {
+                if (!iter->is("ObjectType") || !__document.properties(*iter, properties) || properties.empty()) { continue; }
+                if (__types.count(properties[0].string()) == 0) { continue; }
+                
+                BinaryProperty count;
+                if (fbxbinary::value(__document, *iter, "Count", count)) { __definitions += count.integer(); }
+            }
+        }
+        
+        auto data = __document.data();
+        __writer.write(data, fbxbinary::header);
+        for (auto iter = roots.begin(); iter != roots.end(); iter++)
+        {
+            if (dropped(*iter, nullptr)) { continue; }
+            if (!copy(*iter, nullptr)) { return false; }
+        }
+        __writer.fill(__document.headerSize());
+        
+        // footer alignment depends on where it starts, so rebuild it when it looks as written by the SDK
+        auto tail = (roots.empty() ? fbxbinary::header : roots.back().end) + __document.headerSize();
+        auto size = __document.size();
+        if (tail + 16 + 4 + 4 + 120 + 16 <= size && memcmp(data + size - 16, fbxbinary::footerMagic, 16) == 0)
+        {
+            fbxbinary::footer(__writer, data + tail, __document.version());
+        }
+        else if (tail < size)
+        {
+            __writer.write(data + tail, size - tail);
+        }
+        return true;
+    }
+};
+
+bool rewrite(std::string filename)
+{
+    BinaryDocument document;
+    std::string error;
+    if (!document.open(filename, error))
+    {
+        output("%s: %s\n", filename.c_str(), error.c_str());
+        return false;
+    }
+    
+    auto filepath = archive::workpath(filename);
+    auto pos = filepath.rfind('.');
+    std::string savename = filepath.substr(0, pos) + "_t" + filepath.substr(pos);
+    
+    BinaryWriter writer;
+    if (!writer.open(savename))
+    {
+        output("%s: unable to write %s\n", filename.c_str(), savename.c_str());
+        return false;
+    }
+    
+    // a partial file must not be taken for a trimmed one
+    BinaryTrimmer trimmer(document, writer);
+    auto success = trimmer.trim();
+    if (!writer.close() || !success)
+    {
+        unlink(savename.c_str());
+        output("%s: unable to rewrite\n", filename.c_str());
+        return false;
+    }
+    
+    produced(savename);
+    output(">>> %s\n", savename.c_str());
+    return true;
+}
+
+bool process(std::string filename, FbxManager *pManager, const ExportOptions &options)
+{
+    MappedFileStream source;
+    FbxAutoDestroyPtr<FbxImporter> importer(FbxImporter::Create(pManager, ""));
+    if (!initialize(importer, source, filename, pManager->GetIOSettings()))
+    {
+        return false;
+    }
+    
+    FbxAutoDestroyPtr<FbxScene> scene(FbxScene::Create(pManager, "Scene"));
     if (!importer->Import(scene))
     {
-        return;
+        return false;
     }
     
-    importer->Destroy();
+    importer.Reset();
     
     trim(scene);
     
-    auto pos = filename.rfind('.');
-    std::string savename = filename.substr(0, pos) + "_t" + filename.substr(pos);
+    auto filepath = archive::workpath(filename);
+    auto pos = filepath.rfind('.');
+    std::string savename = filepath.substr(0, pos) + "_t" + filepath.substr(pos);
     
-    auto exporter = FbxExporter::Create(pManager, "");
-    if (!exporter->Initialize(savename.c_str(), -1, pManager->GetIOSettings()))
+    BufferedFileStream target;
+    FbxAutoDestroyPtr<FbxExporter> exporter(FbxExporter::Create(pManager, ""));
+    if (!initialize(exporter, target, savename, pManager->GetIOSettings(), options))
     {
-        return;
+        return false;
     }
     
     if (!exporter->Export(scene))
     {
-        return;
+        return false;
     }
     
-    printf(">>> %s\n", savename.c_str());
-    
-    scene->Destroy();
+    produced(savename);
+    output(">>> %s\n", savename.c_str());
+    return true;
 }
 
 int main(int argc, const char * argv[])
 {
-    if (argc <= 1) {return 1;}
-    
-    FbxManager* pManager = FbxManager::Create();
-    pManager->SetIOSettings(FbxIOSettings::Create(pManager, IOSROOT));
+    CommandOptions options(argc, argv);
+    memory::install();
     
-    for (auto i = 1; i < argc; i++)
+    ToolDriver<FbxManager> tool;
+    tool.name = "fbxtrim";
+    tool.version = FBXTOOLS_VERSION " " FBXSDK_VERSION_STRING;
+    tool.create = []
     {
-        printf("[%d/%d] %s\n", i, argc - 1, argv[i]);
-        process(argv[i], pManager);
-    }
+        FbxManager* pManager = FbxManager::Create();
+        pManager->SetIOSettings(FbxIOSettings::Create(pManager, IOSROOT));
+        return pManager;
+    };
+    tool.destroy = [](FbxManager *pManager)
+    {
+        pManager->Destroy();
+    };
+    tool.announce = [](ArgumentOptions &args, int i, int count)
+    {
+        output("[%d/%d] %s\n", i + 1, count, args.filename.c_str());
+    };
+    tool.process = [](FbxManager *pManager, ArgumentOptions &args)
+    {
+        // ?binary rewrites binary FBX records in place of an SDK import and export
+        if (args.get("binary")) { return rewrite(args.filename); }
+        return process(args.filename, pManager, ExportOptions(args));
+    };
     
-    pManager->Destroy();
-    return 0;
+    return drive(tool, options);
 }
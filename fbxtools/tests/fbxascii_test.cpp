@@ -0,0 +1,185 @@
+//
+//  fbxascii_test.cpp
+//  fbxtools
+//
+//  Created by LARRYHOU on 2026/10/19.
+//  Copyright © 2026 LARRYHOU. All rights reserved.
+//
+//  g++ -std=gnu++14 -pthread -I common tests/fbxascii_test.cpp -lz && ./a.out
+//
+
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+#include <fbxascii.h>
+
+static int failures = 0;
+
+#define CHECK(condition) do { if (!(condition)) { fprintf(stderr, "[E] %s:%d %s\n", __FILE__, __LINE__, #condition); ++failures; } } while (0)
+
+// an animation curve as the SDK writes it, key attribute data are int32 bit patterns of floats
+const char curve[] =
+    "; FBX 7.4.0 project file\n"
+    "FBXHeaderExtension:  {\n"
+    "\tFBXHeaderVersion: 1003\n"
+    "\tFBXVersion: 7400\n"
+    "}\n"
+    "Objects:  {\n"
+    "\tAnimationCurve: 7, \"AnimCurve::\", \"\" {\n"
+    "\t\tDefault: 0\n"
+    "\t\tKeyVer: 4008\n"
+    "\t\tKeyTime: *3 {\n"
+    "\t\t\ta: 0,23093079000,46186158000\n"
+    "\t\t} \n"
+    "\t\tKeyValueFloat: *3 {\n"
+    "\t\t\ta: 1.5,-2.25,0.1\n"
+    "\t\t} \n"
+    "\t\tKeyAttrFlags: *2 {\n"
+    "\t\t\ta: 24840,24836\n"
+    "\t\t} \n"
+    "\t\tKeyAttrDataFloat: *8 {\n"
+    "\t\t\ta: 218434821,0,255082548,0,-1082130432,1065353216,\n"
+    "\t\t\t3212836864,0\n"
+    "\t\t} \n"
+    "\t\tKeyAttrRefCount: *2 {\n"
+    "\t\t\ta: 1,2\n"
+    "\t\t} \n"
+    "\t}\n"
+    "}\n"
+    "Connections:  {\n"
+    "\tC: \"OP\", 7, 5, \"d|X\"\n"
+    "}\n";
+
+// nan and inf as printf spells them and a NURBS surface whose multiplicities are integer arrays
+const char nurbs[] =
+    "; FBX 7.4.0 project file\n"
+    "FBXHeaderExtension:  {\n"
+    "\tFBXHeaderVersion: 1003\n"
+    "\tFBXVersion: 7400\n"
+    "}\n"
+    "Objects:  {\n"
+    "\tGeometry: 9, \"Geometry::\", \"NurbsSurface\" {\n"
+    "\t\tType: \"NurbsSurface\"\n"
+    "\t\tNurbsSurfaceVersion: 100\n"
+    "\t\tPoints: *4 {\n"
+    "\t\t\ta: 1,nan,-inf,2\n"
+    "\t\t} \n"
+    "\t\tMultiplicityU: *3 {\n"
+    "\t\t\ta: 4,1,4\n"
+    "\t\t} \n"
+    "\t\tMultiplicityV: *2 {\n"
+    "\t\t\ta: 4,4\n"
+    "\t\t} \n"
+    "\t\tKnotVectorU: *2 {\n"
+    "\t\t\ta: 0,1\n"
+    "\t\t} \n"
+    "\t\tProperties70:  {\n"
+    "\t\t\tP: \"X\", \"Number\", \"\", \"A\",nan\n"
+    "\t\t\tP: \"Y\", \"Number\", \"\", \"A\",inf\n"
+    "\t\t\tP: \"Z\", \"Number\", \"\", \"A\",-NaN\n"
+    "\t\t}\n"
+    "\t}\n"
+    "}\n"
+    "Connections:  {\n"
+    "\tC: \"OO\", 9, 0\n"
+    "}\n";
+
+template<typename T>
+bool same(const BinaryProperty &property, char type, const std::vector<T> &expected)
+{
+    std::vector<char> bytes;
+    if (property.type != type || property.length != expected.size() || !property.bytes(bytes)) { return false; }
+    return bytes.size() == expected.size() * sizeof(T) && memcmp(bytes.data(), expected.data(), bytes.size()) == 0;
+}
+
+bool array(const BinaryDocument &document, const BinaryRecord &parent, const char *name, BinaryProperty &property)
+{
+    BinaryRecord record;
+    std::vector<BinaryProperty> properties;
+    if (!document.find(parent, name, record) || !document.properties(record, properties) || properties.size() != 1) { return false; }
+    property = properties[0];
+    return true;
+}
+
+// converts the curve with and without compression and reads every key array back
+void roundtrip(const std::string &source, const std::string &target, int level)
+{
+    std::string error;
+    AsciiDocument ascii;
+    CHECK(ascii.open(source, error) && ascii.parse(error));
+    CHECK(ascii.decode(1, level, 0, error));
+    CHECK(ascii.write(target, error));
+    
+    BinaryDocument binary;
+    BinaryRecord objects, node;
+    CHECK(binary.open(target, error));
+    CHECK(binary.find("Objects", objects));
+    CHECK(binary.find(objects, "AnimationCurve", node));
+    
+    BinaryProperty property;
+    CHECK(array(binary, node, "KeyTime", property) && same<int64_t>(property, 'l', {0, 23093079000LL, 46186158000LL}));
+    CHECK(array(binary, node, "KeyValueFloat", property) && same<float>(property, 'f', {1.5f, -2.25f, 0.1f}));
+    CHECK(array(binary, node, "KeyAttrFlags", property) && same<int32_t>(property, 'i', {24840, 24836}));
+    CHECK(array(binary, node, "KeyAttrRefCount", property) && same<int32_t>(property, 'i', {1, 2}));
+    
+    // bits kept as they are, 1065353216 is 1.0f and both spellings of -1.0f land on the same pattern
+    uint32_t bits[] = {218434821, 0, 255082548, 0, 0xbf800000, 0x3f800000, 0xbf800000, 0};
+    CHECK(array(binary, node, "KeyAttrDataFloat", property) && same<uint32_t>(property, 'f', std::vector<uint32_t>(bits, bits + 8)));
+    CHECK(level == 0 || property.encoding == 1);
+}
+
+// specials land in D properties and double arrays, multiplicities stay int32
+void specials(const std::string &source, const std::string &target)
+{
+    std::string error;
+    AsciiDocument ascii;
+    CHECK(ascii.open(source, error) && ascii.parse(error));
+    CHECK(ascii.decode(1, 0, 0, error));
+    CHECK(ascii.write(target, error));
+    
+    BinaryDocument binary;
+    BinaryRecord objects, node;
+    CHECK(binary.open(target, error));
+    CHECK(binary.find("Objects", objects));
+    CHECK(binary.find(objects, "Geometry", node));
+    
+    BinaryProperty property;
+    CHECK(array(binary, node, "MultiplicityU", property) && same<int32_t>(property, 'i', {4, 1, 4}));
+    CHECK(array(binary, node, "MultiplicityV", property) && same<int32_t>(property, 'i', {4, 4}));
+    CHECK(array(binary, node, "KnotVectorU", property) && same<double>(property, 'd', {0, 1}));
+    
+    std::vector<double> points;
+    CHECK(array(binary, node, "Points", property) && property.type == 'd' && property.values(points) && points.size() == 4);
+    CHECK(points.size() == 4 && points[0] == 1 && isnan(points[1]) && isinf(points[2]) && points[2] < 0 && points[3] == 2);
+    
+    CHECK(fbxbinary::property(binary, node, "X", property) && property.type == 'D' && isnan(property.real()));
+    CHECK(fbxbinary::property(binary, node, "Y", property) && property.type == 'D' && isinf(property.real()) && property.real() > 0);
+    CHECK(fbxbinary::property(binary, node, "Z", property) && property.type == 'D' && isnan(property.real()));
+}
+
+bool save(const std::string &filename, const char *text, size_t size)
+{
+    auto fp = fopen(filename.c_str(), "wb");
+    CHECK(fp != nullptr);
+    if (fp == nullptr) { return false; }
+    fwrite(text, 1, size, fp);
+    fclose(fp);
+    return true;
+}
+
+int main(int argc, const char * argv[])
+{
+    std::string source = "/tmp/fbxascii_test.fbx", target = "/tmp/fbxascii_test_bin.fbx";
+    if (!save(source, curve, sizeof(curve) - 1)) { return 1; }
+    roundtrip(source, target, 0);
+    roundtrip(source, target, 6);
+    
+    if (!save(source, nurbs, sizeof(nurbs) - 1)) { return 1; }
+    specials(source, target);
+    unlink(source.c_str());
+    unlink(target.c_str());
+    
+    printf("%s\n", failures == 0 ? "[+] fbxascii" : "[E] fbxascii");
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,108 @@
+//
+//  fbxbinary_test.cpp
+//  fbxtools
+//
+//  Created by LARRYHOU on 2026/10/19.
+//  Copyright © 2026 LARRYHOU. All rights reserved.
+//
+//  g++ -std=gnu++14 -pthread -I common tests/fbxbinary_test.cpp -lz && ./a.out
+//
+
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+#include <fbxbinary.h>
+
+static int failures = 0;
+
+#define CHECK(condition) do { if (!(condition)) { fprintf(stderr, "[E] %s:%d %s\n", __FILE__, __LINE__, #condition); ++failures; } } while (0)
+
+std::vector<char> slurp(const std::string &filename)
+{
+    std::vector<char> data;
+    auto fp = fopen(filename.c_str(), "rb");
+    if (fp == nullptr) { return data; }
+    char buffer[4096];
+    size_t size;
+    while ((size = fread(buffer, 1, sizeof(buffer), fp)) > 0) { data.insert(data.end(), buffer, buffer + size); }
+    fclose(fp);
+    return data;
+}
+
+// a patch that starts in flushed bytes and ends in the buffer
+void straddle(const std::string &filename)
+{
+    BinaryWriter writer(8);
+    CHECK(writer.open(filename));
+    writer.write<uint32_t>(0x11111111);
+    writer.write<uint32_t>(0);
+    writer.write<uint32_t>(0); // flushes the first 8 bytes
+    
+    uint32_t values[2] = {0xaaaaaaaa, 0xbbbbbbbb};
+    writer.patch(4, values, 8);
+    CHECK(writer.close());
+    
+    auto data = slurp(filename);
+    CHECK(data.size() == 12);
+    if (data.size() != 12) { return; }
+    CHECK(fbxbinary::read<uint32_t>(data.data()) == 0x11111111);
+    CHECK(fbxbinary::read<uint32_t>(data.data() + 4) == 0xaaaaaaaa);
+    CHECK(fbxbinary::read<uint32_t>(data.data() + 8) == 0xbbbbbbbb);
+}
+
+void document(const std::string &filename, size_t capacity, uint32_t version)
+{
+    BinaryWriter writer(capacity);
+    CHECK(writer.open(filename));
+    
+    BinaryRecordWriter w(writer, version);
+    w.header();
+    w.begin("Objects");
+    for (auto i = 0; i < 5; i++)
+    {
+        w.begin("Geometry");
+        w.add((int64_t)i);
+        w.add("Geometry::Mesh");
+        w.add(std::vector<double>(3 * (i + 1), 0.5));
+        w.record("Version", (int32_t)124);
+        w.end();
+    }
+    w.end();
+    w.footer("0123456789abcdef");
+    CHECK(writer.close());
+}
+
+// every buffer size puts the flush somewhere else, count and byte fields of pre-7500 records included
+void flushes(const std::string &filename)
+{
+    const uint32_t versions[] = {7400, 7500};
+    for (auto v = 0; v < 2; v++)
+    {
+        document(filename, 8 << 20, versions[v]);
+        auto reference = slurp(filename);
+        CHECK(!reference.empty());
+        
+        for (size_t capacity = 1; capacity <= 96; capacity++)
+        {
+            document(filename, capacity, versions[v]);
+            auto data = slurp(filename);
+            if (data != reference)
+            {
+                fprintf(stderr, "[E] version %u differs with a %zu byte buffer\n", versions[v], capacity);
+                ++failures;
+            }
+        }
+    }
+}
+
+int main(int argc, const char * argv[])
+{
+    std::string filename = "/tmp/fbxbinary_test.fbx";
+    straddle(filename);
+    flushes(filename);
+    unlink(filename.c_str());
+    
+    printf("%s\n", failures == 0 ? "[+] fbxbinary" : "[E] fbxbinary");
+    return failures == 0 ? 0 : 1;
+}
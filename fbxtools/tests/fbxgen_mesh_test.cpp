@@ -0,0 +1,119 @@
+//
+//  fbxgen_mesh_test.cpp
+//  fbxtools
+//
+//  Created by LARRYHOU on 2026/10/19.
+//  Copyright © 2026 LARRYHOU. All rights reserved.
+//
+//  needs the FBX SDK library, prints a skip notice when its headers aren't found
+//  g++ -std=gnu++14 -pthread -I common -I include tests/fbxgen_mesh_test.cpp -L <sdk>/lib -lfbxsdk -lz && ./a.out
+//
+
+#include <stdio.h>
+
+#if __has_include(<fbxsdk.h>)
+
+#define main fbxgen_main
+#include "../fbxgen/main.cpp"
+#undef main
+
+static int failures = 0;
+
+#define CHECK(condition) do { if (!(condition)) { fprintf(stderr, "[E] %s:%d %s\n", __FILE__, __LINE__, #condition); ++failures; } } while (0)
+
+FbxVector3 vector3(double x, double y, double z)
+{
+    FbxVector3 v;
+    v[0] = x;
+    v[1] = y;
+    v[2] = z;
+    return v;
+}
+
+// a grid of quads split into triangles, every layer element differs per vertex
+void grid(MeshAsset &asset, int size)
+{
+    asset.name = "Grid";
+    for (auto y = 0; y <= size; y++)
+    {
+        for (auto x = 0; x <= size; x++)
+        {
+            asset.vertices.push_back(vector3(x, y, (x * 7 + y * 3) % 5));
+            asset.normals.push_back(vector3(0, 0, x % 2 ? 1 : -1));
+            asset.uvs.push_back(FbxVector2((double)x / size, (double)y / size));
+            asset.tangents.push_back(FbxVector4(1, 0, 0, y % 2 ? 1 : -1));
+        }
+    }
+    
+    for (auto y = 0; y < size; y++)
+    {
+        for (auto x = 0; x < size; x++)
+        {
+            uint32_t a = y * (size + 1) + x, b = a + 1, c = a + size + 1, d = c + 1;
+            uint32_t quad[] = {a, b, d, a, d, c};
+            asset.triangles.insert(asset.triangles.end(), quad, quad + 6);
+        }
+    }
+}
+
+// the mesh against the asset it was built from, not only against the other path
+void expect(FbxMesh *mesh, const MeshAsset &asset)
+{
+    CHECK(mesh->GetControlPointsCount() == asset.vertices.size());
+    for (auto i = 0; i < mesh->GetControlPointsCount() && i < asset.vertices.size(); i++)
+    {
+        auto &p = mesh->GetControlPoints()[i];
+        auto &v = asset.vertices[i];
+        CHECK(p[0] == v[0] && p[1] == v[1] && p[2] == v[2]);
+    }
+    
+    CHECK(mesh->GetPolygonCount() == asset.triangles.size() / 3);
+    for (auto i = 0; i < mesh->GetPolygonCount(); i++)
+    {
+        CHECK(mesh->GetPolygonSize(i) == 3);
+        for (auto k = 0; k < 3; k++) { CHECK(mesh->GetPolygonVertex(i, k) == (int)asset.triangles[i * 3 + k]); }
+    }
+    
+    auto layer = mesh->GetLayer(0);
+    CHECK(layer->GetNormals()->GetDirectArray().GetCount() == asset.normals.size());
+    CHECK(layer->GetUVs()->GetDirectArray().GetCount() == asset.uvs.size());
+    CHECK(layer->GetTangents()->GetDirectArray().GetCount() == asset.tangents.size());
+    for (auto i = 0; i < asset.tangents.size(); i++) { CHECK(layer->GetTangents()->GetDirectArray().GetAt(i) == asset.tangents[i]); }
+}
+
+int main(int argc, const char * argv[])
+{
+    auto manager = FbxManager::Create();
+    auto scene = FbxScene::Create(manager, "Scene");
+    
+    MeshAsset asset;
+    grid(asset, 16);
+    
+    FbxMesh *meshes[2];
+    for (auto n = 0; n < 2; n++)
+    {
+        meshes[n] = FbxMesh::Create(scene, asset.name.c_str());
+        meshes[n]->CreateLayer();
+        build_mesh(meshes[n], meshes[n]->GetLayer(0), asset, n == 0);
+        expect(meshes[n], asset);
+    }
+    CHECK(same_mesh(meshes[0], meshes[1]));
+    
+    // same_mesh() has to notice a layer element that differs
+    meshes[1]->GetLayer(0)->GetUVs()->GetDirectArray().SetAt(5, FbxVector2(-1, -1));
+    CHECK(!same_mesh(meshes[0], meshes[1]));
+    
+    manager->Destroy();
+    printf("%s\n", failures == 0 ? "[+] fbxgen mesh" : "[E] fbxgen mesh");
+    return failures == 0 ? 0 : 1;
+}
+
+#else
+
+int main(int argc, const char * argv[])
+{
+    printf("[-] fbxgen mesh skipped, no FBX SDK\n");
+    return 0;
+}
+
+#endif